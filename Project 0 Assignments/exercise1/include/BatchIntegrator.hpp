@@ -0,0 +1,70 @@
+#ifndef BATCH_INTEGRATOR_HPP
+#define BATCH_INTEGRATOR_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "OrbitBatch.hpp"
+
+/**
+ * Integrates a whole OrbitBatch in lockstep
+ * It uses the same LeapFrog (kick drift kick) and RK2/RK4 schemes as the scalar integrators,
+ * but instead of a std::function per orbit the kepler acceleration is written out
+ * as a plain loop over the arrays, which the compiler vectorizes with -O3 -fno-math-errno
+ */
+class BatchIntegrator
+{
+private:
+    double G;
+    double M;
+    double m;
+
+    // scratch arrays for the intermediate stages, reused between the steps
+    std::vector<double> ax, ay;
+    std::vector<double> stage_x, stage_y, stage_vx, stage_vy;
+    std::vector<double> sum_x, sum_y, sum_vx, sum_vy;
+
+    /**
+     * Computes the kepler acceleration of n lanes
+     * a = -G * M * r / |r|^3
+     */
+    void accelerations(const double *x, const double *y, double *ax, double *ay, std::size_t n) const;
+
+    void resize_scratch(std::size_t n);
+
+    /**
+     * One leap frog step which starts from the accelerations already in ax, ay
+     * and leaves the ones at the new positions there
+     */
+    void kick_drift_kick(OrbitBatch &batch);
+
+public:
+    BatchIntegrator(double G, double M, double m) : G(G), M(M), m(m) {}
+
+    /**
+     * Fills in the initial energy and angular momentum of every lane
+     * has to be called once after all orbits have been added
+     */
+    void prepare(OrbitBatch &batch) const;
+
+    // a single step of each of the schemes, every lane uses its own time step
+    void leap_frog_step(OrbitBatch &batch);
+    void runge_kutta_step(int level, OrbitBatch &batch);
+
+    /**
+     * Performs n_steps of the chosen scheme on all lanes
+     * since every lane has its own dt, lane i ends at n_steps * dt_i
+     */
+    void integrate_leap_frog(OrbitBatch &batch, int n_steps);
+    void integrate_runge_kutta(int level, OrbitBatch &batch, int n_steps);
+
+    // conserved quantities of every lane
+    std::vector<double> energies(const OrbitBatch &batch) const;
+    std::vector<double> angular_moments(const OrbitBatch &batch) const;
+
+    // relative drift compared to the initial values
+    std::vector<double> energy_errors(const OrbitBatch &batch) const;
+    std::vector<double> angular_momentum_errors(const OrbitBatch &batch) const;
+};
+
+#endif
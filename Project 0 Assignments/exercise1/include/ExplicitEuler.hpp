@@ -29,7 +29,7 @@ public:
     // now we define the integrate function
     // Defining this inside the header file is now okey, since this will only be included in the main class
     // when this class will be used in multiple files -> then we would take it outside and create a cpp file
-    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass)
+    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass, const RecordingOptions &options = RecordingOptions())
     {
         //calculate the initial parameters
         Vector2D initial_velocity(0, std::sqrt(1 + eccentricity));
@@ -43,19 +43,21 @@ public:
             eccentricity,
             dt,
             initial_energy,
-            initial_angular_momentum
+            initial_angular_momentum,
+            options
         );
         
         //calculate the number of time steps we need -> cast to an int and add one more step
         int n_steps = static_cast<int>(t_max / dt);
         
         
+        // the current state, the result only keeps some of the steps
+        Vector2D current_position = initial_position;
+        Vector2D current_velocity = initial_velocity;
+
         // now we perform the explicit euler integration
         for(int i = 0; i < n_steps; i++)
         {
-            // make a reference to the current position and velocity for easier access
-            Vector2D& current_position = result.positions.back();
-            Vector2D& current_velocity = result.velocities.back();
 
 
             // calculate the next step
@@ -65,12 +67,18 @@ public:
             auto new_velocity = current_velocity + acceleration * dt;
 
             // store the new position and velocity
-            result.positions.push_back(new_position);
-            result.velocities.push_back(new_velocity);
-            result.energies.push_back(total_energy_function(new_position, new_velocity));
-            result.angular_moments.push_back(angular_momentum_function(new_position, new_velocity));
+            result.record(
+                new_position,
+                new_velocity,
+                total_energy_function(new_position, new_velocity),
+                angular_momentum_function(new_position, new_velocity));
+
+            current_position = new_position;
+            current_velocity = new_velocity;
         }
     
+        result.finish();
+    
         return result;
     }
 };
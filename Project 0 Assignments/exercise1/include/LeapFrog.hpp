@@ -2,6 +2,7 @@
 #define LEAPFROG_HPP
 
 #include <iostream>
+#include <cmath>
 #include "Vector2D.hpp"
 #include "SimulationResult.hpp"
 #include <functional>
@@ -28,8 +29,30 @@ public:
         this->angular_momentum_function = angular_momentum_function;
     }
 
+    // the two building blocks of the leap frog, also used by the higher order compositions
+    void kick(Vector2D &velocity, const Vector2D &position, double dt) const
+    {
+        velocity += rdotdot(position) * dt;
+    }
+
+    void drift(Vector2D &position, const Vector2D &velocity, double dt) const
+    {
+        position += velocity * dt;
+    }
+
+    // a single kick drift kick step
+    void step(Vector2D &position, Vector2D &velocity, double dt) const
+    {
+        // update the velocity half a step
+        kick(velocity, position, dt/2);
+
+        // update the total position as well as the velocity
+        drift(position, velocity, dt);
+        kick(velocity, position, dt/2);
+    }
+
     // again we implement this here because it is a simple method and is quite short
-    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass) const
+    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass, const RecordingOptions &options = RecordingOptions()) const
     {
         Vector2D initial_velocity(0, std::sqrt(1 + eccentricity));
         auto initial_energy = total_energy_function(initial_position, initial_velocity);
@@ -41,35 +64,33 @@ public:
             eccentricity,
             dt,
             initial_energy,
-            initial_angular_momentum
+            initial_angular_momentum,
+            options
         );
 
         int n_steps = static_cast<int>(t_max / dt);
 
 
-        auto current_position = result.positions.back();
-        auto current_velocity = result.velocities.back();
+        auto current_position = initial_position;
+        auto current_velocity = initial_velocity;
         
         for(int i = 0; i < n_steps; i++)
         {
-            // update the velocity half a step
-            auto velocity_half_step = current_velocity + rdotdot(current_position) * dt/2;
-            
-            // update the total position as well as the velocity
-            current_position += velocity_half_step * dt;
-            current_velocity = velocity_half_step + rdotdot(current_position) * dt/2;
+            step(current_position, current_velocity, dt);
 
 
             // append new positions to the grid
-            result.positions.push_back(current_position);
-            result.velocities.push_back(current_velocity);
-    
-            // append energy and total momentum to the grid
-            result.energies.push_back(total_energy_function(current_position, current_velocity));
-            result.angular_moments.push_back(angular_momentum_function(current_position, current_velocity));
+            result.record(
+                current_position,
+                current_velocity,
+                total_energy_function(current_position, current_velocity),
+                angular_momentum_function(current_position, current_velocity));
         }
 
 
+        result.finish();
+
+
         return result;
     }
 };
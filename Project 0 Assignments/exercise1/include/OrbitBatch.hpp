@@ -0,0 +1,72 @@
+#ifndef ORBIT_BATCH_HPP
+#define ORBIT_BATCH_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "Vector2D.hpp"
+
+/**
+ * Holds many independent orbits in a structure-of-arrays layout
+ * every orbit is one "lane": lane i lives at index i of every array
+ * this way a single loop over the arrays touches contiguous memory and
+ * the compiler is able to put several orbits into one SIMD register
+ */
+struct OrbitBatch
+{
+    // phase space of every lane
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> vx;
+    std::vector<double> vy;
+
+    // each lane can have its own time step, so we can scan over dt as well
+    std::vector<double> time_steps;
+
+    // initial conditions, which we keep to compute the drift later on
+    std::vector<double> eccentricities;
+    std::vector<double> initial_energies;
+    std::vector<double> initial_angular_moments;
+
+    std::size_t size() const { return x.size(); }
+
+    void reserve(std::size_t n)
+    {
+        x.reserve(n);
+        y.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+        time_steps.reserve(n);
+        eccentricities.reserve(n);
+        initial_energies.reserve(n);
+        initial_angular_moments.reserve(n);
+    }
+
+    /**
+     * Adds one orbit with the same initial conditions the scalar integrators use
+     * the velocity is perpendicular to the position with magnitude sqrt(1 + e)
+     * the initial energy and angular momentum are filled in by the integrator
+     *
+     * @param initial_position starting position of the orbit
+     * @param eccentricity eccentricity which defines the initial velocity
+     * @param dt time step used for this lane
+     */
+    void add_orbit(const Vector2D &initial_position, double eccentricity, double dt)
+    {
+        x.push_back(initial_position.x);
+        y.push_back(initial_position.y);
+        vx.push_back(0.0);
+        vy.push_back(std::sqrt(1 + eccentricity));
+
+        time_steps.push_back(dt);
+        eccentricities.push_back(eccentricity);
+        initial_energies.push_back(0.0);
+        initial_angular_moments.push_back(0.0);
+    }
+
+    Vector2D position(std::size_t i) const { return Vector2D(x[i], y[i]); }
+    Vector2D velocity(std::size_t i) const { return Vector2D(vx[i], vy[i]); }
+};
+
+#endif
@@ -32,7 +32,7 @@ public:
         angular_momentum_function = am_func;
     }
 
-    SimulationResult integrate(int level, const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass) const;
+    SimulationResult integrate(int level, const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass, const RecordingOptions &options = RecordingOptions()) const;
 };
 
 #endif
\ No newline at end of file
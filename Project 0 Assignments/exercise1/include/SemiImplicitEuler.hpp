@@ -2,6 +2,7 @@
 #define SEMI_IMPLICIT_EULER_HPP
 
 #include <iostream>
+#include <cmath>
 #include "Vector2D.hpp"
 #include "SimulationResult.hpp"
 #include <functional>
@@ -29,7 +30,7 @@ public:
     }
 
     // again we implement this here because it is a simple method and is quite short
-    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass) const
+    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass, const RecordingOptions &options = RecordingOptions()) const
     {
         Vector2D initial_velocity(0, std::sqrt(1 + eccentricity));
         auto initial_energy = total_energy_function(initial_position, initial_velocity);
@@ -41,14 +42,15 @@ public:
             eccentricity,
             dt,
             initial_energy,
-            initial_angular_momentum
+            initial_angular_momentum,
+            options
         );
 
         int n_steps = static_cast<int>(t_max / dt);
 
 
-        auto current_position = result.positions.back();
-        auto current_velocity = result.velocities.back();
+        auto current_position = initial_position;
+        auto current_velocity = initial_velocity;
         
         for(int i = 0; i < n_steps; i++)
         {
@@ -57,15 +59,17 @@ public:
 
 
             // append new positions to the grid
-            result.positions.push_back(current_position);
-            result.velocities.push_back(current_velocity);
-    
-            // append energy and total momentum to the grid
-            result.energies.push_back(total_energy_function(current_position, current_velocity));
-            result.angular_moments.push_back(angular_momentum_function(current_position, current_velocity));
+            result.record(
+                current_position,
+                current_velocity,
+                total_energy_function(current_position, current_velocity),
+                angular_momentum_function(current_position, current_velocity));
         }
 
 
+        result.finish();
+
+
         return result;
     }
 };
@@ -2,8 +2,47 @@
 #define SIMULATIONRESULT_HPP
 
 #include "Vector2D.hpp"
+#include "TrajectoryWriter.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
 #include <vector>
 
+// defines which steps of an integration are kept
+struct RecordingOptions
+{
+    // keep every k-th step
+    int every = 1;
+
+    // if set, the kept steps are spaced logarithmically instead (1, 2, 3, ..., 10, 12, 15, ...)
+    bool log_spaced = false;
+    int points_per_decade = 20;
+
+    // the kept steps are stored in the vectors of the result
+    bool keep_in_memory = true;
+
+    // if a filename is given, the kept steps are streamed to this file while integrating
+    std::string stream_filename = "";
+    std::string method_name = "";
+    std::size_t buffer_size = std::size_t(1) << 16;
+};
+
+// reductions over every single step, also the ones which are not kept
+struct ConservationStatistics
+{
+    long n_steps = 0;
+
+    // relative errors compared to the initial values
+    double min_energy_error = 0.0;
+    double max_energy_error = 0.0;
+    double mean_energy_error = 0.0;
+    double max_angular_momentum_error = 0.0;
+
+    // errors after the last step
+    double final_energy_error = 0.0;
+    double final_angular_momentum_error = 0.0;
+};
+
 struct SimulationResult{
 
     // initial conditions
@@ -13,7 +52,7 @@ struct SimulationResult{
 
     // simulation information
     double time_step;
-    
+
     // position and velocities
     std::vector<Vector2D> positions;
     std::vector<Vector2D> velocities;
@@ -22,18 +61,57 @@ struct SimulationResult{
     std::vector<double> energies;
     std::vector<double> angular_moments;
 
+    // the step number of each entry in the vectors above
+    std::vector<long> steps;
+
+    ConservationStatistics statistics;
+
 
     SimulationResult(
         const Vector2D & initial_position,
-        const Vector2D & initial_velocity, 
-        double eccentricity, 
-        double dt, 
-        double initial_energy, 
-        double initial_angular_momentum
+        const Vector2D & initial_velocity,
+        double eccentricity,
+        double dt,
+        double initial_energy,
+        double initial_angular_momentum,
+        const RecordingOptions & options = RecordingOptions()
     );
 
+    /**
+     * Adds the state after the next step
+     * it always updates the statistics, but only keeps the step if the cadence says so
+     */
+    void record(const Vector2D & position, const Vector2D & velocity, double energy, double angular_momentum);
+
+    /**
+     * Has to be called after the last step
+     * keeps the final state (if it was not already) and writes out the stream
+     */
+    void finish();
+
     void export_to_file(const std::string& filename, const std::string& method_name) const;
+
+private:
+    RecordingOptions options;
+    std::unique_ptr<TrajectoryWriter> writer;
+
+    double initial_energy;
+    double initial_angular_momentum;
+
+    // the current step and the next step which will be kept
+    long step;
+    long next_kept_step;
+    bool last_kept;
+
+    // the last state, so finish can keep it
+    Vector2D last_position;
+    Vector2D last_velocity;
+    double last_energy;
+    double last_angular_momentum;
+
+    void keep(const Vector2D & position, const Vector2D & velocity, double energy, double angular_momentum);
+    void advance_cadence();
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,104 @@
+#ifndef SWEEP_RUNNER_HPP
+#define SWEEP_RUNNER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Vector2D.hpp"
+#include "SimulationResult.hpp"
+
+enum class IntegrationMethod
+{
+    explicit_euler,
+    runge_kutta_2,
+    runge_kutta_4,
+    leap_frog,
+    semi_implicit_euler,
+    yoshida_4,
+    yoshida_6,
+    forest_ruth
+};
+
+std::string method_name(IntegrationMethod method);
+
+// one point of the parameter grid
+struct SweepCase
+{
+    IntegrationMethod method;
+    double dt;
+    double eccentricity;
+    double t_max;
+
+    int n_steps() const { return static_cast<int>(t_max / dt); }
+};
+
+// the summary we keep of every case, the trajectory itself is thrown away
+struct SweepMetrics
+{
+    SweepCase sweep_case;
+
+    double final_energy_error;
+    double max_energy_error;
+    double angular_momentum_drift;
+    double wall_time_ms;
+};
+
+/**
+ * Runs a grid of integrations concurrently on a small pool of threads
+ * By default a case only keeps the running statistics and no trajectory, if the recording
+ * options keep steps in memory we only start a new case if the estimated memory of all
+ * running cases stays below the budget (a case larger than the budget is still run, but on its own)
+ */
+class SweepRunner
+{
+private:
+    std::function<Vector2D(const Vector2D &)> rdotdot;
+    std::function<double(const Vector2D &, const Vector2D &)> total_energy_function;
+    std::function<double(const Vector2D &, const Vector2D &)> angular_momentum_function;
+
+    unsigned int n_threads;
+    std::size_t memory_budget;
+    RecordingOptions recording_options;
+
+    SweepMetrics run_case(const SweepCase &sweep_case) const;
+
+public:
+    /**
+     * @param n_threads number of worker threads, 0 uses all hardware threads
+     * @param memory_budget maximum number of bytes the running cases may use together
+     * @param recording_options which steps each case keeps, by default only the statistics
+     */
+    SweepRunner(
+        std::function<Vector2D(const Vector2D &)> rdotdot_func,
+        std::function<double(const Vector2D &, const Vector2D &)> energy_func,
+        std::function<double(const Vector2D &, const Vector2D &)> am_func,
+        unsigned int n_threads = 0,
+        std::size_t memory_budget = std::size_t(1) << 30,
+        const RecordingOptions &recording_options = RecordingOptions{.keep_in_memory = false});
+
+    /**
+     * Creates the cartesian product of all given parameters
+     */
+    static std::vector<SweepCase> cartesian_grid(
+        const std::vector<IntegrationMethod> &methods,
+        const std::vector<double> &time_steps,
+        const std::vector<double> &eccentricities,
+        const std::vector<double> &t_maxs);
+
+    /**
+     * Estimated number of bytes a SimulationResult of this case needs
+     */
+    std::size_t estimate_memory(const SweepCase &sweep_case) const;
+
+    /**
+     * Runs all cases and returns the metrics in the same order as the cases
+     * the longest cases are started first, so the total time is close to the longest case
+     */
+    std::vector<SweepMetrics> run(const std::vector<SweepCase> &cases) const;
+
+    static void export_table(const std::vector<SweepMetrics> &metrics, const std::string &filename);
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef SYMPLECTIC_COMPOSITION_HPP
+#define SYMPLECTIC_COMPOSITION_HPP
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "Vector2D.hpp"
+#include "SimulationResult.hpp"
+#include "LeapFrog.hpp"
+
+enum class CompositionScheme
+{
+    yoshida_4,
+    yoshida_6,
+    forest_ruth
+};
+
+/**
+ * Higher order symplectic integrators, built from the kick and drift steps of the LeapFrog
+ * One step is the sequence kick(k_0) drift(d_0) kick(k_1) drift(d_1) ... drift(d_n-1) kick(k_n)
+ * where every coefficient is a fraction of dt
+ *
+ * Yoshida (1990): leap frog steps with the weights w_i, the half kicks of two
+ * neighbouring leap frog steps are merged, so one step costs n + 1 force evaluations
+ * Forest & Ruth (1990): the position version (drift first) of the 4th order scheme
+ */
+class SymplecticComposition
+{
+private:
+    LeapFrog leap_frog;
+
+    std::function<double(const Vector2D &, const Vector2D &)> total_energy_function;
+    std::function<double(const Vector2D &, const Vector2D &)> angular_momentum_function;
+
+    std::vector<double> kicks;
+    std::vector<double> drifts;
+
+    // turns the weights of the leap frog steps into the merged kick and drift coefficients
+    void set_leap_frog_weights(const std::vector<double> &weights)
+    {
+        kicks.assign(weights.size() + 1, 0.0);
+        drifts = weights;
+        for (std::size_t i = 0; i < weights.size(); i++)
+        {
+            kicks[i] += weights[i] / 2;
+            kicks[i + 1] += weights[i] / 2;
+        }
+    }
+
+public:
+    SymplecticComposition(
+        CompositionScheme scheme,
+        std::function<Vector2D(const Vector2D &)> function,
+        std::function<double(const Vector2D &, const Vector2D &)> energy_function,
+        std::function<double(const Vector2D &, const Vector2D &)> angular_momentum_function
+    ) : leap_frog(function, energy_function, angular_momentum_function)
+    {
+        this->total_energy_function = energy_function;
+        this->angular_momentum_function = angular_momentum_function;
+
+        // the triple jump which cancels the third order error of the leap frog
+        const double theta = 1.0 / (2.0 - std::cbrt(2.0));
+
+        if (scheme == CompositionScheme::yoshida_4)
+        {
+            set_leap_frog_weights({theta, 1.0 - 2.0 * theta, theta});
+        }
+        else if (scheme == CompositionScheme::yoshida_6)
+        {
+            // solution A of Yoshida (1990), table 1
+            const double w1 = -1.17767998417887;
+            const double w2 = 0.235573213359357;
+            const double w3 = 0.784513610477560;
+            const double w0 = 1.0 - 2.0 * (w1 + w2 + w3);
+            set_leap_frog_weights({w3, w2, w1, w0, w1, w2, w3});
+        }
+        else
+        {
+            kicks = {0.0, theta, 1.0 - 2.0 * theta, theta, 0.0};
+            drifts = {theta / 2, (1.0 - theta) / 2, (1.0 - theta) / 2, theta / 2};
+        }
+    }
+
+    // a single step of the composition
+    void step(Vector2D &position, Vector2D &velocity, double dt) const
+    {
+        for (std::size_t i = 0; i < drifts.size(); i++)
+        {
+            if (kicks[i] != 0.0)
+                leap_frog.kick(velocity, position, kicks[i] * dt);
+            leap_frog.drift(position, velocity, drifts[i] * dt);
+        }
+        if (kicks.back() != 0.0)
+            leap_frog.kick(velocity, position, kicks.back() * dt);
+    }
+
+    // same interface as the other integrators
+    SimulationResult integrate(const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass, const RecordingOptions &options = RecordingOptions()) const
+    {
+        Vector2D initial_velocity(0, std::sqrt(1 + eccentricity));
+        auto initial_energy = total_energy_function(initial_position, initial_velocity);
+        auto initial_angular_momentum = angular_momentum_function(initial_position, initial_velocity);
+
+        SimulationResult result(
+            initial_position,
+            initial_velocity,
+            eccentricity,
+            dt,
+            initial_energy,
+            initial_angular_momentum,
+            options
+        );
+
+        int n_steps = static_cast<int>(t_max / dt);
+
+        auto current_position = initial_position;
+        auto current_velocity = initial_velocity;
+
+        for(int i = 0; i < n_steps; i++)
+        {
+            step(current_position, current_velocity, dt);
+
+            // append new positions to the grid
+            result.record(
+                current_position,
+                current_velocity,
+                total_energy_function(current_position, current_velocity),
+                angular_momentum_function(current_position, current_velocity));
+        }
+
+        result.finish();
+
+        return result;
+    }
+};
+
+#endif
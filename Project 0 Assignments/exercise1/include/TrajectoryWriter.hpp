@@ -0,0 +1,42 @@
+#ifndef TRAJECTORY_WRITER_HPP
+#define TRAJECTORY_WRITER_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Vector2D.hpp"
+
+/**
+ * Streams the recorded steps of an integration to a file while it runs
+ * Every step is one line: step;time;x;y;vx;vy;energy;angular_momentum
+ * The lines are formatted into a buffer of fixed size which is written out once it is full,
+ * so the memory needed does not depend on the length of the integration
+ */
+class TrajectoryWriter
+{
+private:
+    std::ofstream file;
+    std::vector<char> buffer;
+    std::size_t used;
+
+    void flush();
+
+public:
+    TrajectoryWriter(const std::string &filename, const std::string &method_name, double dt, std::size_t buffer_size);
+    ~TrajectoryWriter();
+
+    // a writer owns its file, so it can not be copied
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    bool is_open() const { return file.is_open(); }
+
+    void write(long step, double time, const Vector2D &position, const Vector2D &velocity, double energy, double angular_momentum);
+
+    // writes out what is left in the buffer
+    void close();
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "BatchIntegrator.hpp"
+#include <algorithm>
+#include <cmath>
+
+// all loops below only work on plain double arrays without any function calls (except sqrt)
+// std::sqrt may set errno, which is a side effect that stops gcc and clang from vectorizing the
+// acceleration loop, so the project is built with -fno-math-errno (see .vscode/tasks.json)
+// and -O3, then every loop over the lanes processes several lanes per instruction
+// the arrays are passed as __restrict parameters, gcc ignores __restrict on local pointers and
+// would otherwise need too many run time checks whether the arrays overlap
+
+namespace
+{
+    // v += a * dt * fraction, the kick of the leap frog and the velocity update of the runge kutta
+    void kick(double *__restrict v, const double *__restrict a, const double *__restrict dt, double fraction, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+            v[i] += a[i] * dt[i] * fraction;
+    }
+
+    // one axis of a runge kutta stage: accumulates its weighted derivative (velocity, acceleration)
+    // and moves s_pos, s_vel to the point where the next stage is evaluated
+    void runge_kutta_stage(double *__restrict k_pos, double *__restrict k_vel, double *__restrict s_pos, double *__restrict s_vel,
+                           const double *__restrict pos, const double *__restrict vel, const double *__restrict a,
+                           const double *__restrict dt, double weight, double next_offset, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double stage_velocity = s_vel[i];
+            k_pos[i] += weight * stage_velocity;
+            k_vel[i] += weight * a[i];
+
+            s_pos[i] = pos[i] + stage_velocity * next_offset * dt[i];
+            s_vel[i] = vel[i] + a[i] * next_offset * dt[i];
+        }
+    }
+}
+
+void BatchIntegrator::accelerations(const double *__restrict x, const double *__restrict y, double *__restrict ax, double *__restrict ay, std::size_t n) const
+{
+    const double gm = G * M;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double r2 = x[i] * x[i] + y[i] * y[i];
+        double inv_r = 1.0 / std::sqrt(r2);
+        double amplification = -gm * inv_r * inv_r * inv_r;
+
+        ax[i] = x[i] * amplification;
+        ay[i] = y[i] * amplification;
+    }
+}
+
+void BatchIntegrator::resize_scratch(std::size_t n)
+{
+    // resize does nothing if the size did not change, so this is cheap to call every step
+    for (auto *v : {&ax, &ay, &stage_x, &stage_y, &stage_vx, &stage_vy, &sum_x, &sum_y, &sum_vx, &sum_vy})
+        v->resize(n);
+}
+
+void BatchIntegrator::prepare(OrbitBatch &batch) const
+{
+    batch.initial_energies = energies(batch);
+    batch.initial_angular_moments = angular_moments(batch);
+}
+
+void BatchIntegrator::leap_frog_step(OrbitBatch &batch)
+{
+    resize_scratch(batch.size());
+    accelerations(batch.x.data(), batch.y.data(), ax.data(), ay.data(), batch.size());
+    kick_drift_kick(batch);
+}
+
+void BatchIntegrator::kick_drift_kick(OrbitBatch &batch)
+{
+    const std::size_t n = batch.size();
+    const double *dt = batch.time_steps.data();
+
+    // kick half a step and then drift a full step (a drift is a kick of the position with the velocity)
+    kick(batch.vx.data(), ax.data(), dt, 0.5, n);
+    kick(batch.vy.data(), ay.data(), dt, 0.5, n);
+    kick(batch.x.data(), batch.vx.data(), dt, 1.0, n);
+    kick(batch.y.data(), batch.vy.data(), dt, 1.0, n);
+
+    // and the second half kick with the new position, these accelerations are kept for the next step
+    accelerations(batch.x.data(), batch.y.data(), ax.data(), ay.data(), n);
+    kick(batch.vx.data(), ax.data(), dt, 0.5, n);
+    kick(batch.vy.data(), ay.data(), dt, 0.5, n);
+}
+
+void BatchIntegrator::runge_kutta_step(int level, OrbitBatch &batch)
+{
+    const std::size_t n = batch.size();
+    resize_scratch(n);
+    const double *dt = batch.time_steps.data();
+
+    // the stages are the same as in RungeKutta.cpp:
+    // k_i = (velocity at stage i, acceleration at stage i)
+    // for RK2 the weights are (1, 1) / 2, for RK4 (1, 2, 2, 1) / 6
+    const int n_stages = (level == 4) ? 4 : 2;
+    const double weights_rk2[2] = {1.0 / 2, 1.0 / 2};
+    const double weights_rk4[4] = {1.0 / 6, 2.0 / 6, 2.0 / 6, 1.0 / 6};
+    const double offsets_rk2[2] = {0.0, 1.0 / 2};
+    const double offsets_rk4[4] = {0.0, 1.0 / 2, 1.0 / 2, 1.0};
+    const double *weights = (level == 4) ? weights_rk4 : weights_rk2;
+    const double *offsets = (level == 4) ? offsets_rk4 : offsets_rk2;
+
+    // stage one is evaluated at the current position
+    std::copy(batch.x.begin(), batch.x.end(), stage_x.begin());
+    std::copy(batch.y.begin(), batch.y.end(), stage_y.begin());
+    std::copy(batch.vx.begin(), batch.vx.end(), stage_vx.begin());
+    std::copy(batch.vy.begin(), batch.vy.end(), stage_vy.begin());
+    for (auto *v : {&sum_x, &sum_y, &sum_vx, &sum_vy})
+        std::fill(v->begin(), v->end(), 0.0);
+
+    for (int stage = 0; stage < n_stages; stage++)
+    {
+        accelerations(stage_x.data(), stage_y.data(), ax.data(), ay.data(), n);
+
+        const double weight = weights[stage];
+        const double next_offset = (stage + 1 < n_stages) ? offsets[stage + 1] : 0.0;
+        runge_kutta_stage(sum_x.data(), sum_vx.data(), stage_x.data(), stage_vx.data(),
+                          batch.x.data(), batch.vx.data(), ax.data(), dt, weight, next_offset, n);
+        runge_kutta_stage(sum_y.data(), sum_vy.data(), stage_y.data(), stage_vy.data(),
+                          batch.y.data(), batch.vy.data(), ay.data(), dt, weight, next_offset, n);
+    }
+
+    kick(batch.x.data(), sum_x.data(), dt, 1.0, n);
+    kick(batch.y.data(), sum_y.data(), dt, 1.0, n);
+    kick(batch.vx.data(), sum_vx.data(), dt, 1.0, n);
+    kick(batch.vy.data(), sum_vy.data(), dt, 1.0, n);
+}
+
+void BatchIntegrator::integrate_leap_frog(OrbitBatch &batch, int n_steps)
+{
+    // the accelerations at the end of a step are the ones at the start of the next,
+    // so they are only computed once per step
+    if (n_steps <= 0)
+        return;
+    leap_frog_step(batch);
+    for (int i = 1; i < n_steps; i++)
+        kick_drift_kick(batch);
+}
+
+void BatchIntegrator::integrate_runge_kutta(int level, OrbitBatch &batch, int n_steps)
+{
+    for (int i = 0; i < n_steps; i++)
+        runge_kutta_step(level, batch);
+}
+
+std::vector<double> BatchIntegrator::energies(const OrbitBatch &batch) const
+{
+    std::vector<double> result(batch.size());
+    for (std::size_t i = 0; i < batch.size(); i++)
+    {
+        double v2 = batch.vx[i] * batch.vx[i] + batch.vy[i] * batch.vy[i];
+        double r = std::sqrt(batch.x[i] * batch.x[i] + batch.y[i] * batch.y[i]);
+        result[i] = 0.5 * m * v2 - G * M * m / r;
+    }
+    return result;
+}
+
+std::vector<double> BatchIntegrator::angular_moments(const OrbitBatch &batch) const
+{
+    // same convention as in main.cpp, in 2D this is a scalar
+    std::vector<double> result(batch.size());
+    for (std::size_t i = 0; i < batch.size(); i++)
+        result[i] = batch.x[i] * batch.vy[i] - batch.y[i] * batch.vx[i];
+    return result;
+}
+
+std::vector<double> BatchIntegrator::energy_errors(const OrbitBatch &batch) const
+{
+    auto result = energies(batch);
+    for (std::size_t i = 0; i < result.size(); i++)
+        result[i] = std::abs((result[i] - batch.initial_energies[i]) / batch.initial_energies[i]);
+    return result;
+}
+
+std::vector<double> BatchIntegrator::angular_momentum_errors(const OrbitBatch &batch) const
+{
+    auto result = angular_moments(batch);
+    for (std::size_t i = 0; i < result.size(); i++)
+        result[i] = std::abs((result[i] - batch.initial_angular_moments[i]) / batch.initial_angular_moments[i]);
+    return result;
+}
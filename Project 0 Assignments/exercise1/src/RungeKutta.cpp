@@ -47,7 +47,7 @@ Phase RungeKutta::k4(const Vector2D &position, const Vector2D &velocity, double
         rdotdot(temporary_position));
 }
 
-SimulationResult RungeKutta::integrate(int level, const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass) const
+SimulationResult RungeKutta::integrate(int level, const Vector2D &initial_position, double eccentricity, double t_max, double dt, double mass, const RecordingOptions &options) const
 {
     // calculate the initial parameters
     Vector2D initial_velocity(0, std::sqrt(1 + eccentricity));
@@ -61,12 +61,13 @@ SimulationResult RungeKutta::integrate(int level, const Vector2D &initial_positi
         eccentricity,
         dt,
         initial_energy,
-        initial_angular_momentum);
+        initial_angular_momentum,
+        options);
 
     int n_steps = static_cast<int>(t_max / dt);
 
-    Vector2D current_position = result.positions.back();
-    Vector2D current_velocity = result.velocities.back();
+    Vector2D current_position = initial_position;
+    Vector2D current_velocity = initial_velocity;
 
     for (int i = 0; i < n_steps; i++)
     {
@@ -97,14 +98,16 @@ SimulationResult RungeKutta::integrate(int level, const Vector2D &initial_positi
         current_velocity += velocity_increment;
 
         // append new positions to the grid
-        result.positions.push_back(current_position);
-        result.velocities.push_back(current_velocity);
-
-        result.energies.push_back(total_energy_function(current_position, current_velocity));
-        result.angular_moments.push_back(angular_momentum_function(current_position, current_velocity));
+        result.record(
+            current_position,
+            current_velocity,
+            total_energy_function(current_position, current_velocity),
+            angular_momentum_function(current_position, current_velocity));
     }
 
     // perform the runge kutta 2 integration
 
+    result.finish();
+
     return result;
 }
@@ -1,74 +1,193 @@
 #include "SimulationResult.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 
 
 
 
-SimulationResult::SimulationResult(const Vector2D & initial_position, const Vector2D & initial_velocity, double eccentricity, double dt, double initial_energy, double initial_angular_momentum)
+SimulationResult::SimulationResult(const Vector2D & initial_position, const Vector2D & initial_velocity, double eccentricity, double dt, double initial_energy, double initial_angular_momentum, const RecordingOptions & options)
 {
     this->time_step = dt;
     this->eccentricity = eccentricity;
     this->initial_position = initial_position;
     this->initial_velocity = initial_velocity;
 
-    this->positions.push_back(initial_position);
-    this->velocities.push_back(initial_velocity);
+    this->options = options;
+    this->options.every = std::max(options.every, 1);
+    this->initial_energy = initial_energy;
+    this->initial_angular_momentum = initial_angular_momentum;
 
-    this->energies.push_back(initial_energy);
-    this->angular_moments.push_back(initial_angular_momentum);
+    if (!options.stream_filename.empty())
+    {
+        this->writer = std::make_unique<TrajectoryWriter>(options.stream_filename, options.method_name, dt, options.buffer_size);
+    }
+
+    // the initial state is always kept
+    this->step = 0;
+    this->next_kept_step = 0;
+    keep(initial_position, initial_velocity, initial_energy, initial_angular_momentum);
+    advance_cadence();
+}
+
+void SimulationResult::advance_cadence()
+{
+    if (options.log_spaced)
+    {
+        // the next step on the logarithmic grid, at least one step further
+        double factor = std::pow(10.0, 1.0 / std::max(options.points_per_decade, 1));
+        long next = static_cast<long>(std::ceil(next_kept_step * factor));
+        next_kept_step = std::max(next, next_kept_step + 1);
+    }
+    else
+    {
+        next_kept_step += options.every;
+    }
+}
+
+void SimulationResult::keep(const Vector2D & position, const Vector2D & velocity, double energy, double angular_momentum)
+{
+    if (options.keep_in_memory)
+    {
+        positions.push_back(position);
+        velocities.push_back(velocity);
+        energies.push_back(energy);
+        angular_moments.push_back(angular_momentum);
+        steps.push_back(step);
+    }
+
+    if (writer)
+    {
+        writer->write(step, step * time_step, position, velocity, energy, angular_momentum);
+    }
+
+    last_kept = true;
+}
+
+void SimulationResult::record(const Vector2D & position, const Vector2D & velocity, double energy, double angular_momentum)
+{
+    step++;
+
+    // update the running reductions with every step
+    double energy_error = std::abs((energy - initial_energy) / initial_energy);
+    double angular_momentum_error = std::abs((angular_momentum - initial_angular_momentum) / initial_angular_momentum);
+
+    if (statistics.n_steps == 0)
+    {
+        statistics.min_energy_error = energy_error;
+        statistics.max_energy_error = energy_error;
+    }
+    statistics.n_steps++;
+    statistics.min_energy_error = std::min(statistics.min_energy_error, energy_error);
+    statistics.max_energy_error = std::max(statistics.max_energy_error, energy_error);
+    statistics.mean_energy_error += (energy_error - statistics.mean_energy_error) / statistics.n_steps;
+    statistics.max_angular_momentum_error = std::max(statistics.max_angular_momentum_error, angular_momentum_error);
+    statistics.final_energy_error = energy_error;
+    statistics.final_angular_momentum_error = angular_momentum_error;
+
+    last_position = position;
+    last_velocity = velocity;
+    last_energy = energy;
+    last_angular_momentum = angular_momentum;
+    last_kept = false;
+
+    if (step >= next_kept_step)
+    {
+        keep(position, velocity, energy, angular_momentum);
+        advance_cadence();
+    }
+}
+
+void SimulationResult::finish()
+{
+    // the final state is always kept
+    if (!last_kept)
+    {
+        keep(last_position, last_velocity, last_energy, last_angular_momentum);
+    }
 
+    if (writer)
+    {
+        writer->close();
+    }
+}
+
+// appends a number in the same format std::to_string uses (6 decimals)
+static void append_number(std::string &output, double value)
+{
+    char characters[400];
+    auto end = std::to_chars(characters, characters + sizeof(characters), value, std::chars_format::fixed, 6).ptr;
+    output.append(characters, end);
 }
 
 void SimulationResult::export_to_file(const std::string &filename, const std::string &method_name) const
 {
-    // add some basic information to the file
     auto file_name = filename + std::to_string(time_step) + ".txt";
-    std::string output = "";
+    std::ofstream file("results/" + file_name);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open file " << file_name << " for writing.\n";
+        return;
+    }
+
+    // instead of building the whole file in memory, we fill a buffer and write it out once it is full
+    const std::size_t buffer_size = std::size_t(1) << 16;
+    std::string output;
+    output.reserve(buffer_size + 128);
+    auto flush_if_full = [&]()
+    {
+        if (output.size() >= buffer_size)
+        {
+            file.write(output.data(), output.size());
+            output.clear();
+        }
+    };
+
+    // add some basic information to the file
     output += std::to_string(time_step) + "\n";
     output += method_name + "\n";
 
-    // append the positions to the output string
-    std::string pos_str = "";
+    // the positions
     for (const Vector2D &pos : positions)
     {
-        pos_str += std::to_string(pos.x) + ";" + std::to_string(pos.y) + " ";
+        append_number(output, pos.x);
+        output += ';';
+        append_number(output, pos.y);
+        output += ' ';
+        flush_if_full();
     }
-    output += pos_str + "\n";
+    output += '\n';
 
-    // append the velocities to the output string
-    std::string vel_str = "";
+    // the velocities
     for (const Vector2D &vel : velocities)
     {
-        vel_str += std::to_string(vel.x) + ";" + std::to_string(vel.y) + " ";
+        append_number(output, vel.x);
+        output += ';';
+        append_number(output, vel.y);
+        output += ' ';
+        flush_if_full();
     }
-    output += vel_str + "\n";
+    output += '\n';
 
-    // append the energies to the output string
-    std::string energy_str = "";
+    // the energies
     for (const auto &e : energies)
     {
-        energy_str += std::to_string(e) + ";";
+        append_number(output, e);
+        output += ';';
+        flush_if_full();
     }
-    output += energy_str + "\n";
+    output += '\n';
 
-    // append the angular momentum to the output string
-    std::string angular_moment_str = "";
-    for(const auto & l : angular_moments)
+    // the angular momentum
+    for (const auto &l : angular_moments)
     {
-        angular_moment_str += std::to_string(l) + ";";
+        append_number(output, l);
+        output += ';';
+        flush_if_full();
     }
-    output += angular_moment_str + "\n";
-
+    output += '\n';
 
-    std::ofstream file("results/" + file_name);
-    if (file.is_open())
-    {
-        file << output;
-        file.close();
-    }
-    else
-    {
-        std::cerr << "Error: Could not open file " << file_name << " for writing.\n";
-    }
+    file.write(output.data(), output.size());
 }
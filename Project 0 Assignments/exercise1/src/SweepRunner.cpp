@@ -0,0 +1,229 @@
+#include "SweepRunner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+#include "SimulationResult.hpp"
+#include "ExplicitEuler.hpp"
+#include "RungeKutta.hpp"
+#include "LeapFrog.hpp"
+#include "SemiImplicitEuler.hpp"
+#include "SymplecticComposition.hpp"
+
+std::string method_name(IntegrationMethod method)
+{
+    switch (method)
+    {
+    case IntegrationMethod::explicit_euler:
+        return "Explicit Euler";
+    case IntegrationMethod::runge_kutta_2:
+        return "Runge Kutta 2";
+    case IntegrationMethod::runge_kutta_4:
+        return "Runge Kutta 4";
+    case IntegrationMethod::leap_frog:
+        return "LeapFrog";
+    case IntegrationMethod::semi_implicit_euler:
+        return "SemiImplicitEuler";
+    case IntegrationMethod::yoshida_4:
+        return "Yoshida 4";
+    case IntegrationMethod::yoshida_6:
+        return "Yoshida 6";
+    case IntegrationMethod::forest_ruth:
+        return "Forest Ruth";
+    }
+    return "Unknown";
+}
+
+SweepRunner::SweepRunner(
+    std::function<Vector2D(const Vector2D &)> rdotdot_func,
+    std::function<double(const Vector2D &, const Vector2D &)> energy_func,
+    std::function<double(const Vector2D &, const Vector2D &)> am_func,
+    unsigned int n_threads,
+    std::size_t memory_budget,
+    const RecordingOptions &recording_options)
+{
+    this->rdotdot = rdotdot_func;
+    this->total_energy_function = energy_func;
+    this->angular_momentum_function = am_func;
+    this->n_threads = n_threads != 0 ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+    this->memory_budget = memory_budget;
+
+    // the cases are written to one table, so they never stream their own files
+    this->recording_options = recording_options;
+    this->recording_options.stream_filename = "";
+}
+
+std::vector<SweepCase> SweepRunner::cartesian_grid(
+    const std::vector<IntegrationMethod> &methods,
+    const std::vector<double> &time_steps,
+    const std::vector<double> &eccentricities,
+    const std::vector<double> &t_maxs)
+{
+    std::vector<SweepCase> cases;
+    cases.reserve(methods.size() * time_steps.size() * eccentricities.size() * t_maxs.size());
+
+    for (const auto &method : methods)
+        for (const auto &dt : time_steps)
+            for (const auto &eccentricity : eccentricities)
+                for (const auto &t_max : t_maxs)
+                    cases.push_back(SweepCase{method, dt, eccentricity, t_max});
+
+    return cases;
+}
+
+std::size_t SweepRunner::estimate_memory(const SweepCase &sweep_case) const
+{
+    std::size_t memory = sizeof(SimulationResult);
+    if (!recording_options.keep_in_memory)
+        return memory;
+
+    // every kept step stores a position, a velocity, an energy, an angular momentum and the step
+    // the vectors are not reserved, so they can overshoot by up to a factor of two
+    std::size_t per_step = 2 * sizeof(Vector2D) + 2 * sizeof(double) + sizeof(long);
+    std::size_t n_steps = static_cast<std::size_t>(std::max(sweep_case.n_steps(), 0)) + 1;
+    std::size_t kept_steps = recording_options.log_spaced ? n_steps : n_steps / recording_options.every + 2;
+    return memory + 2 * per_step * kept_steps;
+}
+
+SweepMetrics SweepRunner::run_case(const SweepCase &sweep_case) const
+{
+    Vector2D initial_position(1.0, 0.0);
+    double mass = 1.0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // the integrators are cheap to create, so every case gets its own one
+    auto simulate = [&]() -> SimulationResult
+    {
+        switch (sweep_case.method)
+        {
+        case IntegrationMethod::explicit_euler:
+            return ExplicitEuler(rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::runge_kutta_2:
+            return RungeKutta(rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(2, initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::runge_kutta_4:
+            return RungeKutta(rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(4, initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::semi_implicit_euler:
+            return SemiImplicitEuler(rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::yoshida_4:
+            return SymplecticComposition(CompositionScheme::yoshida_4, rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::yoshida_6:
+            return SymplecticComposition(CompositionScheme::yoshida_6, rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::forest_ruth:
+            return SymplecticComposition(CompositionScheme::forest_ruth, rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        case IntegrationMethod::leap_frog:
+        default:
+            return LeapFrog(rdotdot, total_energy_function, angular_momentum_function)
+                .integrate(initial_position, sweep_case.eccentricity, sweep_case.t_max, sweep_case.dt, mass, recording_options);
+        }
+    };
+    SimulationResult result = simulate();
+
+    auto stop = std::chrono::steady_clock::now();
+
+    // the result already reduced the trajectory to the few numbers we are interested in
+    SweepMetrics metrics;
+    metrics.sweep_case = sweep_case;
+    metrics.final_energy_error = result.statistics.final_energy_error;
+    metrics.max_energy_error = result.statistics.max_energy_error;
+    metrics.angular_momentum_drift = result.statistics.final_angular_momentum_error;
+    metrics.wall_time_ms = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    return metrics;
+}
+
+std::vector<SweepMetrics> SweepRunner::run(const std::vector<SweepCase> &cases) const
+{
+    std::vector<SweepMetrics> metrics(cases.size());
+
+    // longest processing time first: start the cases with the most steps first,
+    // so that the short ones fill up the gaps at the end
+    std::vector<std::size_t> order(cases.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&cases](std::size_t a, std::size_t b)
+                     { return cases[a].n_steps() > cases[b].n_steps(); });
+
+    std::mutex mutex;
+    std::condition_variable memory_released;
+    std::size_t next = 0;
+    std::size_t memory_in_use = 0;
+    int running = 0;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            std::size_t index;
+            std::size_t memory;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                // wait until the next case fits into the budget, if nothing is running it always fits
+                memory_released.wait(lock, [&]()
+                                     { return next >= order.size() || running == 0 ||
+                                              memory_in_use + estimate_memory(cases[order[next]]) <= memory_budget; });
+                if (next >= order.size())
+                    return;
+
+                index = order[next];
+                memory = estimate_memory(cases[index]);
+
+                next++;
+                memory_in_use += memory;
+                running++;
+            }
+            // the next case in line might be smaller, so the others can check again
+            memory_released.notify_all();
+
+            metrics[index] = run_case(cases[index]);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                memory_in_use -= memory;
+                running--;
+            }
+            memory_released.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned int n_workers = std::min<std::size_t>(n_threads, cases.size());
+    for (unsigned int i = 0; i < n_workers; i++)
+        threads.emplace_back(worker);
+    for (auto &t : threads)
+        t.join();
+
+    return metrics;
+}
+
+void SweepRunner::export_table(const std::vector<SweepMetrics> &metrics, const std::string &filename)
+{
+    std::ofstream file("results/" + filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open file " << filename << " for writing.\n";
+        return;
+    }
+
+    file << "method;dt;eccentricity;t_max;final_energy_error;max_energy_error;angular_momentum_drift;wall_time_ms\n";
+    for (const auto &m : metrics)
+    {
+        file << method_name(m.sweep_case.method) << ";" << m.sweep_case.dt << ";" << m.sweep_case.eccentricity << ";"
+             << m.sweep_case.t_max << ";" << m.final_energy_error << ";" << m.max_energy_error << ";"
+             << m.angular_momentum_drift << ";" << m.wall_time_ms << "\n";
+    }
+}
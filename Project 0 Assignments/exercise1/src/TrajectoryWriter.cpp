@@ -0,0 +1,67 @@
+#include "TrajectoryWriter.hpp"
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+
+// one line has 8 numbers, each at most ~25 characters long
+static constexpr std::size_t max_line_length = 256;
+
+TrajectoryWriter::TrajectoryWriter(const std::string &filename, const std::string &method_name, double dt, std::size_t buffer_size)
+    : file(filename), buffer(std::max(buffer_size, 2 * max_line_length)), used(0)
+{
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open file " << filename << " for writing.\n";
+        return;
+    }
+
+    // same header as export_to_file, followed by the column names
+    file << dt << "\n";
+    file << method_name << "\n";
+    file << "step;time;x;y;vx;vy;energy;angular_momentum\n";
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+void TrajectoryWriter::flush()
+{
+    if (used > 0 && file.is_open())
+        file.write(buffer.data(), used);
+    used = 0;
+}
+
+void TrajectoryWriter::write(long step, double time, const Vector2D &position, const Vector2D &velocity, double energy, double angular_momentum)
+{
+    if (!file.is_open())
+        return;
+
+    // make sure the whole line fits into the buffer
+    if (buffer.size() - used < max_line_length)
+        flush();
+
+    char *current = buffer.data() + used;
+    char *end = buffer.data() + buffer.size();
+
+    // to_chars gives the shortest representation which reads back to the same double
+    current = std::to_chars(current, end, step).ptr;
+    for (double value : {time, position.x, position.y, velocity.x, velocity.y, energy, angular_momentum})
+    {
+        *current++ = ';';
+        current = std::to_chars(current, end, value).ptr;
+    }
+    *current++ = '\n';
+
+    used = current - buffer.data();
+}
+
+void TrajectoryWriter::close()
+{
+    if (file.is_open())
+    {
+        flush();
+        file.close();
+    }
+}
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <fstream>
+#include <chrono>
 
 
 // includes of some of our helper classes
@@ -13,6 +15,9 @@
 #include "RungeKutta.hpp"
 #include "LeapFrog.hpp"
 #include "SemiImplicitEuler.hpp"
+#include "SymplecticComposition.hpp"
+#include "BatchIntegrator.hpp"
+#include "SweepRunner.hpp"
 
 double G = 1.0;
 double M = 1.0;
@@ -41,7 +46,92 @@ double angular_momentum(const Vector2D& r, const Vector2D& v)
     return (r.x * v.y - r.y * v.x);
 }
 
+/**
+ * Scans over the eccentricity and the time step with the batched integrators
+ * all orbits of the scan are advanced together, one lane per (eccentricity, dt)
+ * and only the final energy and angular momentum drift is written out
+ */
+void scan_eccentricities(int max_iter)
+{
+    std::vector<double> time_steps = {0.1, 0.01, 0.001};
+    int n_eccentricities = 1000;
+
+    Vector2D initial_position(1.0, 0.0);
+
+    // every lane is a (eccentricity, dt) combination, e in [0, 0.95)
+    OrbitBatch batch;
+    batch.reserve(n_eccentricities * time_steps.size());
+    for (const auto &dt : time_steps)
+        for (int i = 0; i < n_eccentricities; i++)
+            batch.add_orbit(initial_position, 0.95 * i / n_eccentricities, dt);
+
+    BatchIntegrator integrator(G, M, m);
+    integrator.prepare(batch);
+
+    auto leap_frog_batch = batch;
+    auto runge_kutta_batch = batch;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    integrator.integrate_leap_frog(leap_frog_batch, max_iter);
+    integrator.integrate_runge_kutta(4, runge_kutta_batch, max_iter);
+    auto stop = std::chrono::high_resolution_clock::now();
 
+    std::cout << "  Integrated " << 2 * batch.size() << " orbits with " << max_iter << " steps in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms";
+
+    auto leap_frog_energy = integrator.energy_errors(leap_frog_batch);
+    auto leap_frog_momentum = integrator.angular_momentum_errors(leap_frog_batch);
+    auto runge_kutta_energy = integrator.energy_errors(runge_kutta_batch);
+    auto runge_kutta_momentum = integrator.angular_momentum_errors(runge_kutta_batch);
+
+    std::ofstream file("results/eccentricity_scan.txt");
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open file eccentricity_scan.txt for writing.\n";
+        return;
+    }
+
+    file << "dt;eccentricity;leap_frog_energy_error;leap_frog_angular_momentum_error;runge_kutta_4_energy_error;runge_kutta_4_angular_momentum_error\n";
+    for (std::size_t i = 0; i < batch.size(); i++)
+    {
+        file << batch.time_steps[i] << ";" << batch.eccentricities[i] << ";"
+             << leap_frog_energy[i] << ";" << leap_frog_momentum[i] << ";"
+             << runge_kutta_energy[i] << ";" << runge_kutta_momentum[i] << "\n";
+    }
+}
+
+/**
+ * Runs the convergence study of all methods concurrently
+ * instead of the trajectories only the summary metrics of every case are kept
+ */
+void convergence_study(int max_iter)
+{
+    SweepRunner runner(rdotdot, total_energy, angular_momentum);
+
+    std::vector<IntegrationMethod> methods = {
+        IntegrationMethod::explicit_euler,
+        IntegrationMethod::runge_kutta_2,
+        IntegrationMethod::runge_kutta_4,
+        IntegrationMethod::leap_frog,
+        IntegrationMethod::semi_implicit_euler,
+        IntegrationMethod::yoshida_4,
+        IntegrationMethod::yoshida_6,
+        IntegrationMethod::forest_ruth};
+    std::vector<double> time_steps = {0.1, 0.01, 0.001};
+    std::vector<double> eccentricities = {0.0, 0.5, 0.9};
+
+    // every case covers the same physical time
+    std::vector<double> t_maxs = {0.1 * max_iter};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto metrics = runner.run(SweepRunner::cartesian_grid(methods, time_steps, eccentricities, t_maxs));
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    std::cout << "  Ran " << metrics.size() << " cases in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms";
+
+    SweepRunner::export_table(metrics, "convergence_study.txt");
+}
 
 
 int main() {
@@ -50,6 +140,9 @@ int main() {
     RungeKutta runge_kutta(rdotdot, total_energy, angular_momentum);
     LeapFrog leap_frog(rdotdot, total_energy, angular_momentum);
     SemiImplicitEuler semi_implicit_euler(rdotdot, total_energy, angular_momentum);
+    SymplecticComposition yoshida_4(CompositionScheme::yoshida_4, rdotdot, total_energy, angular_momentum);
+    SymplecticComposition yoshida_6(CompositionScheme::yoshida_6, rdotdot, total_energy, angular_momentum);
+    SymplecticComposition forest_ruth(CompositionScheme::forest_ruth, rdotdot, total_energy, angular_momentum);
     
 
     // create our initial position
@@ -87,7 +180,37 @@ int main() {
         semi_implicit_euler.integrate(initial_position, eccentricity, (dt * max_iter), dt, m).export_to_file("semi_implicit_euler_", "SemiImplicitEuler");
         std::cout << " - complete\n";
 
+        std::cout << "  Using Yoshida 4 Integration";
+        yoshida_4.integrate(initial_position, eccentricity, (dt * max_iter), dt, m).export_to_file("yoshida_4_", "Yoshida 4");
+        std::cout << " - complete\n";
+
+        std::cout << "  Using Yoshida 6 Integration";
+        yoshida_6.integrate(initial_position, eccentricity, (dt * max_iter), dt, m).export_to_file("yoshida_6_", "Yoshida 6");
+        std::cout << " - complete\n";
+
+        std::cout << "  Using Forest Ruth Integration";
+        forest_ruth.integrate(initial_position, eccentricity, (dt * max_iter), dt, m).export_to_file("forest_ruth_", "Forest Ruth");
+        std::cout << " - complete\n";
+
     }
 
+    // a long run only keeps every 100th step and streams it to disk, so it needs constant memory
+    std::cout << "\nLong LeapFrog run with streamed output";
+    RecordingOptions long_run_options;
+    long_run_options.every = 100;
+    long_run_options.keep_in_memory = false;
+    long_run_options.stream_filename = "results/leap_frog_long_run.txt";
+    long_run_options.method_name = "LeapFrog";
+    auto long_run = leap_frog.integrate(initial_position, 0.5, 0.01 * 100 * max_iter, 0.01, m, long_run_options);
+    std::cout << " - complete, mean relative energy error " << long_run.statistics.mean_energy_error << "\n";
+
+    std::cout << "\nScanning eccentricities with the batched integrators\n";
+    scan_eccentricities(max_iter);
+    std::cout << " - complete\n";
+
+    std::cout << "\nRunning the convergence study\n";
+    convergence_study(max_iter);
+    std::cout << " - complete\n";
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef ACCURACYESTIMATOR_HPP
+#define ACCURACYESTIMATOR_HPP
+
+#include <functional>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+
+using Eigen::Vector2d;
+
+// a percentile of the relative force error with its 95% confidence interval
+struct ErrorPercentile
+{
+    double percentile; // e.g. 99
+    double value;
+    double lower;
+    double upper;
+};
+
+struct AccuracyReport
+{
+    int n_samples;
+    double mean;
+    double max;
+    std::vector<ErrorPercentile> percentiles;
+};
+
+/***
+ * Estimates the force error of any solver from a sample of the planets instead of all of them
+ * The planets are sorted by their distance to the center of mass and cut into strata of equal size,
+ * each stratum gets the same number of samples. So the dense center and the sparse outskirts are
+ * both always in the sample, and every sample stands for the same number of planets
+ * The exact accelerations of the samples cost O(k N) and are computed once, with a kernel on plain
+ * arrays which the compiler vectorizes
+ * The confidence intervals come from the order statistics of the sample, they need no assumption about the errors
+ */
+class AccuracyEstimator
+{
+public:
+    // the acceleration of a planet with the solver which is checked
+    using Solver = std::function<Vector2d(const Planet&)>;
+
+    AccuracyEstimator(const std::vector<Planet>& planets, int n_samples, double G = 1, int n_strata = 10,
+                      unsigned int seed = 42, unsigned int n_threads = 0);
+
+    /***
+     * The relative errors |a_solver - a_exact| / |a_exact| of the samples, summarised in the report
+     * the solver is called from several threads at once
+     */
+    AccuracyReport estimate(const Solver& solver, const std::vector<double>& percentiles = {50, 90, 99}) const;
+
+    // the indices of the sampled planets and their exact accelerations
+    const std::vector<int>& samples() const { return _samples; }
+    const std::vector<Vector2d>& exact() const { return _exact; }
+
+    static void print(const AccuracyReport& report);
+
+private:
+    std::vector<Planet> _planets;
+    double _G;
+    unsigned int _n_threads;
+
+    std::vector<int> _samples;
+    std::vector<Vector2d> _exact;
+
+    void _draw_samples(int n_samples, int n_strata, unsigned int seed);
+    void _compute_exact();
+};
+
+#endif // ACCURACYESTIMATOR_HPP
@@ -42,6 +42,18 @@ public:
      */
     void subdivide(std::vector<Planet>& planets);
     Vector2d acceleration(const Planet& p);
+
+    /***
+     * The same with another opening angle, the tree itself does not depend on theta
+     * so one tree can be used for all of them
+     */
+    Vector2d acceleration(const Planet& p, double theta);
+
+    /***
+     * Computes mass, center of mass, expansion coefficient and Q of all nodes
+     * after this the tree is only read, so several threads can walk it at the same time
+     */
+    void precompute();
     int get_max_depth();
     int get_max_planets_in_node();
 
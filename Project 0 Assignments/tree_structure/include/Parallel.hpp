@@ -0,0 +1,37 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/***
+ * The number of threads to use if none is given, at least 1
+ */
+inline unsigned int default_thread_count()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/***
+ * Splits the indices 0..n-1 into n_threads contiguous parts and calls function(begin, end) for each of them on its own thread
+ * the first part is done by the calling thread, so with one thread nothing is started
+ */
+template <typename Function>
+void parallel_for(std::size_t n, Function function, unsigned int n_threads = 0)
+{
+    if (n_threads == 0)
+        n_threads = default_thread_count();
+    n_threads = static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(n_threads, n)));
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < n_threads; t++)
+        threads.emplace_back(function, n * t / n_threads, n * (t + 1) / n_threads);
+
+    function(std::size_t(0), n / n_threads);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,66 @@
+#ifndef SWEEPENGINE_HPP
+#define SWEEPENGINE_HPP
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+
+using Eigen::Vector2d;
+
+// the result of one tree configuration
+struct SweepResult
+{
+    int limit;             // the depth limit the tree was built with
+    double theta;
+    double avg_deviation;  // mean of |a_tree - a_direct| / |a_direct| over all planets
+    double build_time;     // in ms, the same for all thetas of one tree
+    double walk_time;      // in ms, only the tree walks of all planets
+    int max_depth;
+    int max_planets_in_leaf;
+};
+
+/***
+ * Compares the tree with the direct summation for many limits and opening angles
+ * The direct accelerations never change, so they are computed once and kept in a file,
+ * a second run with the same planets reads them back instead of doing the O(N^2) sum again
+ * Every limit gets one tree, which is then walked with all thetas, the planets are split over the threads
+ */
+class SweepEngine
+{
+public:
+    SweepEngine(const std::vector<Planet>& planets, const Vector2d& top_left, const Vector2d& bottom_right,
+                double G = 1, const std::string& cache_file = "", unsigned int n_threads = 0);
+
+    /***
+     * Builds one tree for every limit and walks it with every theta
+     */
+    std::vector<SweepResult> run(const std::vector<int>& limits, const std::vector<double>& thetas);
+
+    // the direct accelerations of all planets
+    const std::vector<Vector2d>& reference() const { return _reference; }
+
+    /***
+     * Prints one line per result: limit theta avg_deviation walk_time max_depth max_planets_in_leaf
+     */
+    static void print(const std::vector<SweepResult>& results);
+
+private:
+    std::vector<Planet> _planets;
+    Vector2d _top_left;
+    Vector2d _bottom_right;
+    double _G;
+    unsigned int _n_threads;
+
+    std::vector<Vector2d> _reference;
+
+    void _compute_reference();
+
+    // a fingerprint of G and of the masses and positions, so a cache of other planets is not used
+    unsigned long long _fingerprint() const;
+    bool _load_reference(const std::string& filename);
+    void _save_reference(const std::string& filename) const;
+};
+
+#endif // SWEEPENGINE_HPP
@@ -0,0 +1,147 @@
+#include "AccuracyEstimator.hpp"
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+using Eigen::Vector2d;
+
+AccuracyEstimator::AccuracyEstimator(const std::vector<Planet>& planets, int n_samples, double G, int n_strata,
+                                     unsigned int seed, unsigned int n_threads)
+    : _planets(planets), _G(G)
+{
+    this->_n_threads = n_threads != 0 ? n_threads : default_thread_count();
+    this->_draw_samples(n_samples, n_strata, seed);
+    this->_compute_exact();
+}
+
+void AccuracyEstimator::_draw_samples(int n_samples, int n_strata, unsigned int seed)
+{
+    int n = static_cast<int>(this->_planets.size());
+    n_samples = std::clamp(n_samples, 0, n);
+    n_strata = std::clamp(n_strata, 1, std::max(n_samples, 1));
+
+    // the planets sorted by their distance to the center of mass
+    Vector2d com(0, 0);
+    double mass = 0.0;
+    for (const auto& p : this->_planets)
+    {
+        com += p.get_mass() * p.get_position();
+        mass += p.get_mass();
+    }
+    com /= mass;
+
+    std::vector<double> radius(n);
+    for (int i = 0; i < n; i++)
+        radius[i] = (this->_planets[i].get_position() - com).norm();
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&radius](int a, int b) { return radius[a] < radius[b]; });
+
+    // every stratum is a contiguous part of the sorted planets, the samples are drawn without replacement
+    std::mt19937 generator(seed);
+    this->_samples.clear();
+    for (int s = 0; s < n_strata; s++)
+    {
+        int first = static_cast<int>(static_cast<long long>(n) * s / n_strata);
+        int last = static_cast<int>(static_cast<long long>(n) * (s + 1) / n_strata);
+        int count = static_cast<int>(static_cast<long long>(n_samples) * (s + 1) / n_strata - static_cast<long long>(n_samples) * s / n_strata);
+
+        std::vector<int> stratum(order.begin() + first, order.begin() + last);
+        std::sample(stratum.begin(), stratum.end(), std::back_inserter(this->_samples), count, generator);
+    }
+}
+
+void AccuracyEstimator::_compute_exact()
+{
+    // the planets as plain arrays, so four of them at a time fit into one Eigen::Array4d
+    std::size_t n = this->_planets.size();
+    std::vector<double> x(n), y(n), m(n);
+    for (std::size_t j = 0; j < n; j++)
+    {
+        x[j] = this->_planets[j].get_position()[0];
+        y[j] = this->_planets[j].get_position()[1];
+        m[j] = this->_planets[j].get_mass();
+    }
+
+    this->_exact.assign(this->_samples.size(), Vector2d(0, 0));
+    parallel_for(this->_samples.size(), [&](std::size_t begin, std::size_t end) {
+        using Eigen::Array4d;
+        for (std::size_t k = begin; k < end; k++)
+        {
+            Vector2d position = this->_planets[this->_samples[k]].get_position();
+
+            // Eigen does the sqrt and the division of four planets with SIMD, a plain loop is not vectorized
+            Array4d ax = Array4d::Zero();
+            Array4d ay = Array4d::Zero();
+            std::size_t j = 0;
+            for (; j + 4 <= n; j += 4)
+            {
+                Array4d dx = Array4d::Map(&x[j]) - position[0];
+                Array4d dy = Array4d::Map(&y[j]) - position[1];
+                Array4d r2 = dx * dx + dy * dy;
+
+                // the planet itself (r2 = 0) does not attract itself
+                Array4d factor = (r2 > 0.0).select(Array4d::Map(&m[j]) / (r2 * r2.sqrt()), 0.0);
+                ax += factor * dx;
+                ay += factor * dy;
+            }
+
+            Vector2d acceleration(ax.sum(), ay.sum());
+            for (; j < n; j++)
+            {
+                Vector2d r(x[j] - position[0], y[j] - position[1]);
+                double r2 = r.squaredNorm();
+                if (r2 > 0.0)
+                    acceleration += m[j] / (r2 * std::sqrt(r2)) * r;
+            }
+            this->_exact[k] = this->_G * acceleration;
+        }
+    }, this->_n_threads);
+}
+
+AccuracyReport AccuracyEstimator::estimate(const Solver& solver, const std::vector<double>& percentiles) const
+{
+    std::vector<double> errors(this->_samples.size(), 0.0);
+    parallel_for(this->_samples.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; k++)
+        {
+            Vector2d acceleration = solver(this->_planets[this->_samples[k]]);
+            errors[k] = (acceleration - this->_exact[k]).norm() / this->_exact[k].norm();
+        }
+    }, this->_n_threads);
+    std::sort(errors.begin(), errors.end());
+
+    AccuracyReport report;
+    report.n_samples = static_cast<int>(errors.size());
+    report.mean = errors.empty() ? 0.0 : std::accumulate(errors.begin(), errors.end(), 0.0) / errors.size();
+    report.max = errors.empty() ? 0.0 : errors.back();
+    if (errors.empty())
+        return report;
+
+    // the number of samples below the q-quantile is binomial(n, q), so the ranks n q -+ 1.96 sqrt(n q (1 - q))
+    // enclose the true quantile with about 95% probability
+    double n = static_cast<double>(errors.size());
+    auto at_rank = [&errors](double rank) {
+        long index = std::lround(std::ceil(rank)) - 1;
+        return errors[std::clamp<long>(index, 0, static_cast<long>(errors.size()) - 1)];
+    };
+    for (double percentile : percentiles)
+    {
+        double q = percentile / 100.0;
+        double spread = 1.96 * std::sqrt(n * q * (1 - q));
+        report.percentiles.push_back({percentile, at_rank(n * q), at_rank(n * q - spread), at_rank(n * q + spread + 1)});
+    }
+    return report;
+}
+
+void AccuracyEstimator::print(const AccuracyReport& report)
+{
+    std::cout << "samples " << report.n_samples << " mean " << report.mean << " max " << report.max << "\n";
+    for (const auto& p : report.percentiles)
+        std::cout << p.percentile << "% " << p.value << " [" << p.lower << ", " << p.upper << "]" << "\n";
+}
@@ -180,6 +180,11 @@ void Node::subdivide(std::vector<Planet> &plan)
 }
 
 Vector2d Node::acceleration(const Planet& p)
+{
+    return this->acceleration(p, this->theta);
+}
+
+Vector2d Node::acceleration(const Planet& p, double theta)
 {
     // first we need to check how far away we are
     Vector2d y = p.get_position() - this->get_com_position();
@@ -198,21 +203,25 @@ Vector2d Node::acceleration(const Planet& p)
             Vector2d r = p.get_position() - other.get_position();
             double r_mag = r.norm();
             if (r_mag > 0.0) // this excludes the attraction to one self
-                force += -G * other.get_mass() * r / std::pow(r_mag, 3);
+                force += -G * other.get_mass() * r / (r_mag * r_mag * r_mag);
         }
     }
     else
     {
         // here we check weather we can use the expansion
-        if ((this->get_expansion_coeff() / y.norm()) < this->theta)
+        if ((this->get_expansion_coeff() / y.norm()) < theta)
         {
             // monopol term
-            Vector2d F_mono = -G * this->get_mass() * y / (pow(y_mag, 3));
+            // the powers as products, std::pow is much slower and this is the innermost part of the walk
+            double y3 = y_mag * y_mag * y_mag;
+            double y5 = y3 * y_mag * y_mag;
+            double y7 = y5 * y_mag * y_mag;
+            Vector2d F_mono = -G * this->get_mass() * y / y3;
 
             // quadropol term
             Vector2d Qy = this->get_Q() * y;
             double yQy = y.transpose() * Qy;
-            Vector2d F_quad = -G * (Qy / pow(y_mag, 5) - y * ((5.0/2.0) * yQy / pow(y_mag, 7)));
+            Vector2d F_quad = -G * (Qy / y5 - y * ((5.0/2.0) * yQy / y7));
 
             force = F_mono + F_quad;
         }
@@ -220,7 +229,7 @@ Vector2d Node::acceleration(const Planet& p)
         {
             // now here we have to open the node
             for(Node & child : this->child_nodes){
-                force += child.acceleration(p);
+                force += child.acceleration(p, theta);
             }
         }
     }
@@ -233,6 +242,18 @@ Vector2d Node::acceleration(const Planet& p)
     return force;
 }
 
+void Node::precompute()
+{
+    // the children first, the values of this node are computed from theirs
+    for(auto & c : this->child_nodes){
+        c.precompute();
+    }
+    this->get_mass();
+    this->get_com_position();
+    this->get_expansion_coeff();
+    this->get_Q();
+}
+
 int Node::get_max_depth()
 {
     int current_depth = this->depth;
@@ -0,0 +1,163 @@
+#include "SweepEngine.hpp"
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "DirectSolver.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using Eigen::Vector2d;
+
+// the first bytes of a reference file, the number is the version of the format
+static const char reference_magic[8] = {'T', 'S', 'R', 'E', 'F', '0', '0', '1'};
+
+SweepEngine::SweepEngine(const std::vector<Planet>& planets, const Vector2d& top_left, const Vector2d& bottom_right,
+                         double G, const std::string& cache_file, unsigned int n_threads)
+    : _planets(planets), _top_left(top_left), _bottom_right(bottom_right), _G(G)
+{
+    this->_n_threads = n_threads != 0 ? n_threads : default_thread_count();
+
+    if (!cache_file.empty() && this->_load_reference(cache_file))
+        return;
+
+    this->_compute_reference();
+    if (!cache_file.empty())
+        this->_save_reference(cache_file);
+}
+
+void SweepEngine::_compute_reference()
+{
+    this->_reference.assign(this->_planets.size(), Vector2d(0, 0));
+    parallel_for(this->_planets.size(), [this](std::size_t begin, std::size_t end) {
+        DirectSolver solver(this->_G);
+        for (std::size_t i = begin; i < end; i++)
+            this->_reference[i] = solver.acceleration(this->_planets[i], this->_planets);
+    }, this->_n_threads);
+}
+
+unsigned long long SweepEngine::_fingerprint() const
+{
+    // FNV-1a over the bytes of all numbers
+    std::uint64_t hash = 1469598103934665603ull;
+    auto add = [&hash](double value) {
+        unsigned char bytes[sizeof(double)];
+        std::memcpy(bytes, &value, sizeof(double));
+        for (unsigned char byte : bytes)
+        {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        }
+    };
+    add(this->_G);
+    for (const auto& p : this->_planets)
+    {
+        add(p.get_mass());
+        add(p.get_position()[0]);
+        add(p.get_position()[1]);
+    }
+    return hash;
+}
+
+bool SweepEngine::_load_reference(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[8];
+    std::uint64_t n = 0;
+    unsigned long long fingerprint = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&n), sizeof(n));
+    file.read(reinterpret_cast<char*>(&fingerprint), sizeof(fingerprint));
+    if (!file || std::memcmp(magic, reference_magic, sizeof(magic)) != 0 || n != this->_planets.size() || fingerprint != this->_fingerprint())
+        return false;
+
+    std::vector<double> values(2 * n);
+    file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(double));
+    if (!file)
+        return false;
+
+    this->_reference.resize(n);
+    for (std::size_t i = 0; i < n; i++)
+        this->_reference[i] = Vector2d(values[2 * i], values[2 * i + 1]);
+    return true;
+}
+
+void SweepEngine::_save_reference(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    std::uint64_t n = this->_reference.size();
+    unsigned long long fingerprint = this->_fingerprint();
+    std::vector<double> values(2 * n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        values[2 * i] = this->_reference[i][0];
+        values[2 * i + 1] = this->_reference[i][1];
+    }
+    file.write(reference_magic, sizeof(reference_magic));
+    file.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    file.write(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint));
+    file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+}
+
+std::vector<SweepResult> SweepEngine::run(const std::vector<int>& limits, const std::vector<double>& thetas)
+{
+    using std::chrono::duration;
+    using std::chrono::high_resolution_clock;
+
+    std::vector<SweepResult> results;
+    for (int limit : limits)
+    {
+        // the theta of the tree is not used, every walk gets its own
+        auto build_start = high_resolution_clock::now();
+        Node root(this->_top_left, this->_bottom_right, limit, 0, this->_G, thetas.empty() ? 0.1 : thetas.front());
+        root.subdivide(this->_planets);
+        root.precompute();
+        double build_time = duration<double, std::milli>(high_resolution_clock::now() - build_start).count();
+
+        int max_depth = root.get_max_depth();
+        int max_planets_in_leaf = root.get_max_planets_in_node();
+
+        for (double theta : thetas)
+        {
+            // every planet has its own place for the deviation, so the threads do not need locks
+            std::vector<double> deviations(this->_planets.size(), 0.0);
+
+            auto walk_start = high_resolution_clock::now();
+            parallel_for(this->_planets.size(), [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++)
+                {
+                    Vector2d acc_tree = root.acceleration(this->_planets[i], theta);
+                    deviations[i] = (acc_tree - this->_reference[i]).norm() / this->_reference[i].norm();
+                }
+            }, this->_n_threads);
+            double walk_time = duration<double, std::milli>(high_resolution_clock::now() - walk_start).count();
+
+            double deviation = 0.0;
+            for (double d : deviations)
+                deviation += d;
+
+            results.push_back({limit, theta, deviation / this->_planets.size(), build_time, walk_time, max_depth, max_planets_in_leaf});
+        }
+    }
+    return results;
+}
+
+void SweepEngine::print(const std::vector<SweepResult>& results)
+{
+    std::cout << "limit theta avg_deviation walk_time max_depth max_planets_in_leaf" << "\n";
+    for (const auto& r : results)
+        std::cout << r.limit << " " << r.theta << " " << r.avg_deviation << " " << r.walk_time << " " << r.max_depth << " " << r.max_planets_in_leaf << "\n";
+}
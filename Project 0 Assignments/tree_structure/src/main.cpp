@@ -1,9 +1,12 @@
+#include <chrono>
 #include <iostream>
 #include <Eigen/Dense>
 #include <vector>
 #include "Planet.hpp"
 #include "Node.hpp"
 #include "DirectSolver.hpp"
+#include "SweepEngine.hpp"
+#include "AccuracyEstimator.hpp"
 
 using Eigen::MatrixXd;
 using Eigen::Vector2d;
@@ -51,35 +54,14 @@ void test_different_tree_depths()
   Vector2d top_left(0, 1000);
   Vector2d bottom_right(1000, 0);
 
-  DirectSolver solver(1);
+  // the direct forces are only computed in the first run, afterwards they come from the file
+  SweepEngine sweep(planets, top_left, bottom_right, 1, "reference_forces.bin");
 
-  std::cout << "" << "limit " << "" << "avg_deviation " << "" << "time " << "max depth " << "max_planets_in_leaf" << "\n";
+  std::vector<int> limits;
   for (int limit = 1; limit < 21; limit++)
-  {
-    Node root(top_left, bottom_right, limit, 0, 1, 0.1);
-    root.subdivide(planets);
-
-    double deviation = 0.0;
-
-    auto start = high_resolution_clock::now();
-    int current = 0;
-    for (const auto &p : planets)
-    {
-      current++;
-      if (current % 1 == 0)
-      {
-
-        Vector2d acc_direct = solver.acceleration(p, planets);
-        Vector2d acc_tree = root.acceleration(p);
+    limits.push_back(limit);
 
-        deviation += (acc_direct - acc_tree).norm() / acc_direct.norm();
-      }
-    }
-    auto stop = high_resolution_clock::now();
-    auto time = duration_cast<milliseconds>(stop - start).count();
-
-    std::cout << "" << limit << " " << deviation / num_of_planets << " " << time << " " << root.get_max_depth() << " " << root.get_max_planets_in_node() << "\n";
-  }
+  SweepEngine::print(sweep.run(limits, {0.1}));
 }
 
 void test_different_opening_anlges()
@@ -90,29 +72,36 @@ void test_different_opening_anlges()
   Vector2d top_left(0, 1000);
   Vector2d bottom_right(1000, 0);
 
-  DirectSolver solver(1);
+  SweepEngine sweep(planets, top_left, bottom_right, 1, "reference_forces.bin");
 
+  // the tree does not depend on theta, so one tree is walked with all of them
+  std::vector<double> thetas;
   for (double i = 1; i < 100; i++)
-  {
-    double t = i / 100;
-    Node root(top_left, bottom_right, 8, 0, 1, t);
-    root.subdivide(planets);
+    thetas.push_back(i / 100);
 
-    double deviation = 0.0;
-    auto start = high_resolution_clock::now();
+  for (const auto &r : sweep.run({8}, thetas))
+    std::cout << "[" << r.theta << "," << r.avg_deviation << "," << r.walk_time << "]," << "\n";
+}
 
-    for (const auto &p : planets)
-    {
+void test_sampled_accuracy()
+{
+  // too many planets for the direct sum of all of them, only the samples are compared
+  int num_planets = 1000000;
+  auto planets = generate_planets(num_planets);
 
-      Vector2d acc_direct = solver.acceleration(p, planets);
-      Vector2d acc_tree = root.acceleration(p);
+  Vector2d top_left(0, 1000);
+  Vector2d bottom_right(1000, 0);
 
-      deviation += (acc_direct - acc_tree).norm() / acc_direct.norm();
-    }
-    auto stop = high_resolution_clock::now();
-    auto time = duration_cast<milliseconds>(stop - start).count();
+  Node root(top_left, bottom_right, 12, 0, 1, 0.5);
+  root.subdivide(planets);
+  root.precompute();
 
-    std::cout << "[" << t << "," << deviation / num_planets << "," << time << "]," << "\n";
+  AccuracyEstimator estimator(planets, 2000);
+  for (double theta : {0.2, 0.5, 0.8})
+  {
+    std::cout << "theta " << theta << "\n";
+    AccuracyEstimator::print(estimator.estimate([&root, theta](const Planet &p)
+                                                { return root.acceleration(p, theta); }));
   }
 }
 
@@ -0,0 +1,105 @@
+#ifndef ASYNCEXPORTER_hpp
+#define ASYNCEXPORTER_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Dense>
+#include "ResultExporter.hpp"
+
+class AsyncExporter;
+
+/*
+Everything needed to write one output step
+A snapshot from AsyncExporter::acquire which is destroyed without being submitted (e.g. after an
+exception while it was filled) gives its buffer back, so the exporter never runs out of buffers
+It must not outlive the exporter it was acquired from
+*/
+struct Snapshot
+{
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<Eigen::Vector3d> forces;
+    std::string filename;
+
+    Snapshot() = default;
+    Snapshot(Snapshot &&other) noexcept;
+    Snapshot &operator=(Snapshot &&other) noexcept;
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+private:
+    friend class AsyncExporter;
+
+    // the exporter this buffer has to go back to, only set between acquire and submit
+    AsyncExporter *_owner = nullptr;
+
+    void _give_back();
+};
+
+/*
+Writes snapshots on a background thread, so the simulation can go on with the next step
+The exporter owns a fixed number of snapshot buffers (2 = double, 3 = triple buffering)
+The simulation acquires a free buffer, fills it and submits it to the writer thread,
+once the file is written the buffer goes back to the free list and is reused
+If all buffers are still waiting to be written, acquire blocks until one is free,
+so a slow disk slows the simulation down instead of filling up the memory
+*/
+class AsyncExporter
+{
+public:
+    AsyncExporter(std::size_t n_buffers = 2, ExportFormat format = ExportFormat::csv, int precision = 6);
+
+    // writes all submitted snapshots before the writer thread is stopped
+    ~AsyncExporter();
+
+    AsyncExporter(const AsyncExporter &) = delete;
+    AsyncExporter &operator=(const AsyncExporter &) = delete;
+
+    /*
+    Returns a free snapshot buffer, blocks if all of them are in use
+    The vectors keep their capacity from the last use, so filling them does not allocate
+    */
+    Snapshot acquire();
+
+    /*
+    Hands the snapshot over to the writer thread
+    */
+    void submit(Snapshot &&snapshot);
+
+    /*
+    Gives an acquired snapshot back without writing it, the destructor of the snapshot does the same
+    */
+    void release(Snapshot &&snapshot);
+
+    /*
+    Waits until all submitted snapshots are written
+    */
+    void flush();
+
+private:
+    std::size_t _n_buffers;
+    std::size_t _in_use = 0; // acquired or waiting to be written
+
+    std::deque<Snapshot> _pending;
+    std::vector<Snapshot> _free;
+    bool _writing = false;
+    bool _stop = false;
+
+    std::mutex _mutex;
+    std::condition_variable _work_available;
+    std::condition_variable _buffer_released;
+
+    // only used by the writer thread, so its buffer is reused for every snapshot
+    ResultExporter _exporter;
+
+    std::thread _writer;
+
+    void _run();
+};
+
+#endif
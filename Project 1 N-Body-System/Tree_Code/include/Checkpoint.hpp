@@ -0,0 +1,68 @@
+#ifndef CHECKPOINT_hpp
+#define CHECKPOINT_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "NBodyIntegrator.hpp"
+#include "ForceSolver.hpp"
+
+// everything which decides how the run goes on, so a restart can check it gets the same setup
+struct SimulationParameters
+{
+    double dt = 0.0;
+    double G = 1.0;
+    double theta = 0.5;
+    int limit = 10; // leaf size of the tree
+    bool quadrupole = true; // whether the tree adds the quadrupole to the monopole
+    double softening = 0.0;
+    IntegrationScheme scheme = IntegrationScheme::leap_frog;
+    ForceBackend backend = ForceBackend::tree;
+    double box_size = 0.0; // > 0 for a periodic box
+
+    bool operator==(const SimulationParameters &) const = default;
+};
+
+/*
+The complete state of a simulation, from which it can go on exactly as if it never stopped
+All doubles are stored as their bits, so reading a checkpoint gives the same numbers
+The accelerations of the last kick are stored as well, the restarted run then uses
+exactly the same ones instead of computing them again (which also saves one force evaluation)
+
+The file is first written under filename + ".tmp", synced to the disk and then renamed, so a crash
+while writing never destroys the last good checkpoint. A checksum at the end detects broken files
+*/
+struct Checkpoint
+{
+    std::uint64_t step = 0;
+    double time = 0.0;
+    SimulationParameters parameters;
+
+    std::vector<Planet> planets;
+    std::vector<Eigen::Vector3d> accelerations; // empty if they were not known
+
+    /*
+    Collects the state of the planets and the integrator
+    */
+    static Checkpoint capture(std::uint64_t step, const SimulationParameters &parameters,
+                              const std::vector<Planet> &planets, const NBodyIntegrator &integrator);
+
+    /*
+    Hands the state of the integrator back, the planets have to be taken from the checkpoint
+    */
+    void restore(NBodyIntegrator &integrator) const;
+
+    /*
+    Writes the checkpoint atomically, returns false if it did not work
+    */
+    bool save(const std::string &filename) const;
+
+    /*
+    Reads a checkpoint, returns false if the file does not exist or is broken
+    */
+    bool load(const std::string &filename);
+};
+
+#endif
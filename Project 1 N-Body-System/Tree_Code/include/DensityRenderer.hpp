@@ -0,0 +1,83 @@
+#ifndef DENSITYRENDERER_hpp
+#define DENSITYRENDERER_hpp
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+
+// the image shows the planets as seen along this axis
+enum class ProjectionAxis
+{
+    x, // horizontal y, vertical z
+    y, // horizontal z, vertical x
+    z  // horizontal x, vertical y
+};
+
+struct RenderSettings
+{
+    std::size_t width = 512;                            // in pixels
+    std::size_t height = 512;
+    Eigen::Vector3d center = Eigen::Vector3d::Zero();   // shown in the middle of the image
+    double half_width = 10.0;                           // half of the shown width, the height follows from the pixels
+    ProjectionAxis axis = ProjectionAxis::z;
+    double smoothing = 1.5;                             // radius of the kernel in pixels, if no smoothing lengths are given
+    double dynamic_range = 1e4;                         // the logarithmic images go from max / dynamic_range to max
+};
+
+/*
+Projected (surface) density of the planets, every planet is spread over the pixels around it with the
+cubic spline kernel. The weights are normalised over all pixels a planet touches, also the ones outside of
+the image, so the mass of the image is exactly the mass inside of it, even for kernels smaller than a pixel
+
+Every thread splats its planets into its own image, which are added up at the end, so no locks are needed
+An image of 512 x 512 pixels is 1 MB as raw floats or 256 kB as PGM, so it can be written every output step
+*/
+class DensityRenderer
+{
+public:
+    DensityRenderer(const RenderSettings &settings = RenderSettings(), unsigned int n_threads = 0);
+
+    /*
+    Renders the planets, all with the smoothing of the settings
+    */
+    const std::vector<float> &render(std::span<const Planet> planets);
+
+    /*
+    Renders the planets, each with its own kernel radius in units of length (e.g. from NeighbourSearch)
+    */
+    const std::vector<float> &render(std::span<const Planet> planets, std::span<const double> smoothing_lengths);
+
+    // mass per area, row after row starting with the top one
+    const std::vector<float> &image() const { return _image; }
+
+    const RenderSettings &settings() const { return _settings; }
+
+    /*
+    Writes the log of the image as 8 bit greyscale PGM, which most image viewers can open
+    */
+    bool write_pgm(const std::string &filename) const;
+
+    /*
+    Writes the image as floats with a numpy header, np.load gives an array of shape (height, width)
+    */
+    bool write_npy(const std::string &filename) const;
+
+private:
+    RenderSettings _settings;
+    unsigned int _n_threads;
+    double _pixel_size;
+
+    // one image per thread, one after the other
+    std::vector<double> _buffers;
+    std::vector<float> _image;
+
+    // without smoothing lengths all planets get the smoothing of the settings
+    const std::vector<float> &_render(std::span<const Planet> planets, std::span<const double> smoothing_lengths);
+
+    void _splat(double *buffer, double column, double row, double radius, double mass) const;
+};
+
+#endif
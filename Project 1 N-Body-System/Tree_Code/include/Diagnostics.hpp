@@ -0,0 +1,61 @@
+#ifndef DIAGNOSTICS_hpp
+#define DIAGNOSTICS_hpp
+
+#include <span>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+
+// the conserved quantities of the whole system at one time
+struct EnergyDiagnostics
+{
+    double time;
+    double kinetic_energy;
+    double potential_energy; // W = 1/2 sum m_i phi_i, every pair counted once
+    double total_energy;
+    double virial_ratio;     // 2K / |W|, 1 in equilibrium
+    double energy_error;     // relative to the first computed total energy
+    Eigen::Vector3d angular_momentum;
+    Eigen::Vector3d momentum;
+};
+
+/*
+Computes energies, virial ratio and momenta of the planets and keeps them for every output step
+The potentials come from the tree walk, so the whole thing costs O(N log N) instead of the O(N^2)
+of the direct summation, if the potentials of the last force evaluation are known it is only O(N)
+*/
+class Diagnostics
+{
+public:
+    Diagnostics(double G, double theta = 0.5, int limit = 10, double softening = 0.0, unsigned int n_threads = 0);
+
+    /*
+    Uses the potentials at the positions of the planets, e.g. from Node::compute_acceleration_and_potential
+    */
+    const EnergyDiagnostics &compute(std::span<const Planet> planets, std::span<const double> potentials, double time);
+
+    /*
+    Builds a tree and computes the potentials with it first
+    */
+    const EnergyDiagnostics &compute(const std::vector<Planet> &planets, double time);
+
+    const std::vector<EnergyDiagnostics> &history() const { return _history; }
+
+    /*
+    Writes one line per computed step, separated by ;
+    */
+    void export_to_file(const std::string &filename) const;
+
+private:
+    double _G;
+    double _theta;
+    int _limit;
+    double _softening;
+    unsigned int _n_threads;
+
+    std::vector<double> _potentials;
+    std::vector<EnergyDiagnostics> _history;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef FFT_hpp
+#define FFT_hpp
+
+#include <complex>
+#include <vector>
+
+/*
+A plain radix 2 Cooley-Tukey FFT, so the particle mesh does not need an external library
+All lengths have to be powers of 2
+*/
+class FFT
+{
+public:
+    FFT(std::size_t n);
+
+    std::size_t size() const { return _n; }
+
+    /*
+    Transforms n values, which are stride apart, in place
+    inverse = true computes the inverse transform without the 1/n
+    */
+    void transform(std::complex<double> *data, std::size_t stride, bool inverse) const;
+
+    /*
+    Transforms a cube of n^3 values (x is the slowest index) in place along all three axes
+    The lines of each axis are distributed over the threads
+    If band > 0, the forward transform assumes that only values with all indices below band are
+    not zero, and the inverse transform only gives correct values with all indices below band
+    This skips the lines which only contain zeros (or are not needed), as for zero padded convolutions
+    */
+    void transform_3d(std::vector<std::complex<double>> &data, bool inverse, unsigned int n_threads = 0, std::size_t band = 0) const;
+
+    static bool is_power_of_two(std::size_t n) { return n > 0 && (n & (n - 1)) == 0; }
+
+private:
+    std::size_t _n;
+    std::vector<std::complex<double>> _twiddles; // exp(-2 pi i k / n) for k < n / 2
+    std::vector<std::size_t> _bit_reversed;
+};
+
+#endif
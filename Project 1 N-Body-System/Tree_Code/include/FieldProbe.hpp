@@ -0,0 +1,60 @@
+#ifndef FIELDPROBE_hpp
+#define FIELDPROBE_hpp
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Node.hpp"
+
+/*
+Acceleration and potential of a tree at arbitrary points (grids, test particles, slices for plots),
+without turning them into planets
+
+The points are sorted along a morton curve and cut into groups of group_size neighbours, each group
+walks the tree only once (see Node::compute_field). The groups are distributed over the threads
+The tree has to stay alive as long as the probe is used
+*/
+class FieldProbe
+{
+public:
+    FieldProbe(const Node &tree, std::size_t group_size = 64, unsigned int n_threads = 0);
+
+    /*
+    Computes the field at all points, the results are in the order of the points
+    */
+    void evaluate(const std::vector<Eigen::Vector3d> &points);
+
+    const std::vector<Eigen::Vector3d> &points() const { return _points; }
+    const std::vector<Eigen::Vector3d> &accelerations() const { return _accelerations; }
+    const std::vector<double> &potentials() const { return _potentials; }
+
+    /*
+    n x n points on the square around center spanned by axis_u and axis_v, from -half_width to half_width
+    along both, row after row (u changes fastest), e.g. for a potential map
+    */
+    static std::vector<Eigen::Vector3d> plane(const Eigen::Vector3d &center, const Eigen::Vector3d &axis_u, const Eigen::Vector3d &axis_v,
+                                              double half_width, std::size_t n);
+
+    /*
+    Writes one line per point with its position, acceleration and potential, separated by ;
+    */
+    void export_to_file(const std::string &filename) const;
+
+    /*
+    The indices of the points sorted along the morton curve through their bounding box,
+    points which are close in this order are close in space
+    */
+    static std::vector<std::size_t> morton_order(const std::vector<Eigen::Vector3d> &points);
+
+private:
+    const Node &_tree;
+    std::size_t _group_size;
+    unsigned int _n_threads;
+
+    std::vector<Eigen::Vector3d> _points;
+    std::vector<Eigen::Vector3d> _accelerations;
+    std::vector<double> _potentials;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef FORCESOLVER_hpp
+#define FORCESOLVER_hpp
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "ParticleMesh.hpp"
+#include "SCFSolver.hpp"
+#include "PeriodicBox.hpp"
+
+enum class ForceBackend
+{
+    direct,  // O(N^2) summation over all pairs, the reference
+    tree,    // Barnes-Hut with monopole and (optionally) quadrupole
+    tree_pm, // long range forces on a mesh, the tree only for the short range part
+    scf      // basis function expansion, only for halos close to a hernquist sphere
+};
+
+std::string backend_name(ForceBackend backend);
+
+struct ForceSettings
+{
+    ForceBackend backend = ForceBackend::tree;
+    double G = 1.0;
+    double softening = 0.0;
+
+    // a box size > 0 makes the system periodic (direct and tree only), the ewald table is cached in ewald_cache
+    double box_size = 0.0;
+    std::string ewald_cache = "";
+    int ewald_grid = 32;
+
+    // tree and tree_pm (tree_pm only uses the monopole, see Node::compute_short_range_acceleration_and_potential)
+    double theta = 0.5;
+    int limit = 10;
+    bool quadrupole = true;
+
+    // tree_pm, the split radius is given in mesh spacings and the cutoff in split radii
+    std::size_t mesh_size = 64;
+    double split = 1.25;
+    double cutoff = 4.5;
+    MassAssignment assignment = MassAssignment::cic;
+
+    // scf
+    int scf_n_max = 8;
+    int scf_l_max = 4;
+    double scf_scale_length = 1.0;
+};
+
+/*
+Computes accelerations and potentials of all planets with the chosen backend
+It can be handed to the NBodyIntegrator as [&solver](const auto & planets) { return solver(planets); }
+*/
+class ForceSolver
+{
+public:
+    ForceSolver(const ForceSettings &settings, unsigned int n_threads = 0);
+
+    std::vector<Eigen::Vector3d> operator()(const std::vector<Planet> &planets);
+
+    // the potentials of the planets of the last call
+    const std::vector<double> &potentials() const { return _potentials; }
+
+    const ForceSettings &settings() const { return _settings; }
+
+private:
+    ForceSettings _settings;
+    unsigned int _n_threads;
+
+    std::unique_ptr<ParticleMesh> _mesh;
+    std::unique_ptr<SCFSolver> _scf;
+    std::unique_ptr<PeriodicBox> _box;
+
+    std::vector<double> _potentials;
+
+    void _direct(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations);
+    void _tree(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations);
+    void _periodic_direct(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations);
+    void _periodic_tree(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations);
+    void _tree_pm(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef FRIENDSOFFRIENDS_hpp
+#define FRIENDSOFFRIENDS_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+
+struct FoFGroup
+{
+    std::size_t n_members;
+    double mass;
+    Eigen::Vector3d center;   // center of mass
+    Eigen::Vector3d velocity; // mass weighted mean velocity
+    double radius;            // distance of the furthest member from the center
+};
+
+/*
+Friends of friends group finder: two planets closer than the linking length are friends,
+a group are all planets which are connected through friends
+
+The pairs are found with the octree, every leaf walks the tree once for all of its planets
+Nodes which lie completely within the linking length of a leaf are linked as a whole without
+looking at single pairs, which keeps dense halos cheap. The groups are merged in a union find
+whose links are set with compare and swap, so the leaves can be worked on in parallel without locks
+*/
+class FriendsOfFriends
+{
+public:
+    FriendsOfFriends(double linking_length, std::size_t min_members = 20, unsigned int n_threads = 0);
+
+    /*
+    The usual linking length: b times the mean distance between the planets in the given volume
+    */
+    static double linking_length(std::size_t n_planets, double volume, double b = 0.2);
+
+    /*
+    Finds the groups, the tree is built with limit planets per leaf
+    */
+    const std::vector<FoFGroup> &find(const std::vector<Planet> &planets, int limit = 8);
+
+    /*
+    The same with an existing tree, which has to be built from planets (see Node::build)
+    */
+    const std::vector<FoFGroup> &find(const std::vector<Planet> &planets, const Node &tree);
+
+    /*
+    The same groups with the loop over all pairs, O(N^2), to check the tree version on small sets
+    */
+    const std::vector<FoFGroup> &find_direct(const std::vector<Planet> &planets);
+
+    /*
+    Whether two memberships (see membership()) put the planets into the same groups, whatever their numbers
+    */
+    static bool same_partition(const std::vector<long> &a, const std::vector<long> &b);
+
+    // the groups with at least min_members planets, the most massive first
+    const std::vector<FoFGroup> &groups() const { return _groups; }
+
+    // for every planet the index of its group in groups(), -1 if it is in none
+    const std::vector<long> &membership() const { return _membership; }
+
+    /*
+    Writes one line per group, separated by ;
+    */
+    void export_to_file(const std::string &filename) const;
+
+private:
+    double _linking_length;
+    std::size_t _min_members;
+    unsigned int _n_threads;
+
+    std::vector<FoFGroup> _groups;
+    std::vector<long> _membership;
+
+    // the union find, every root is its own parent
+    std::unique_ptr<std::atomic<std::size_t>[]> _parent;
+
+    std::size_t _find_root(std::size_t i) const;
+    void _unite(std::size_t a, std::size_t b) const;
+
+    // the first planet of a subtree, which represents it when the whole subtree is linked at once
+    static std::size_t _representative(const Node &node);
+
+    // links everything within a node whose planets are all closer than the linking length
+    void _link_all(const Node &node, std::size_t root) const;
+
+    // links the planets of leaf with everything in node
+    void _link_leaf(const Node &leaf, const Node &node, const Eigen::Vector3d &lower, const Eigen::Vector3d &upper) const;
+
+    void _collect_groups(const std::vector<Planet> &planets);
+};
+
+#endif
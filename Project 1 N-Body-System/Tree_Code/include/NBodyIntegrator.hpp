@@ -0,0 +1,90 @@
+#ifndef NBODYINTEGRATOR_hpp
+#define NBODYINTEGRATOR_hpp
+
+#include <functional>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+
+enum class IntegrationScheme
+{
+    leap_frog,
+    yoshida_4,
+    yoshida_6,
+    forest_ruth
+};
+
+class NBodyIntegrator
+{
+public:
+    // computes the acceleration of every planet, e.g. with the tree or the direct summation
+    using AccelerationFunction = std::function<std::vector<Eigen::Vector3d>(const std::vector<Planet> &)>;
+
+    NBodyIntegrator(AccelerationFunction acceleration_function, IntegrationScheme scheme);
+
+    /*
+    Advances all planets by one step of the chosen scheme
+    One step is the sequence kick(k_0) drift(d_0) kick(k_1) ... drift(d_n-1) kick(k_n)
+    The leap frog and the yoshida schemes end with a kick, whose accelerations are
+    the ones the next step starts with, so they are kept and not computed twice
+    */
+    void step(std::vector<Planet> &planets, double dt);
+
+    /*
+    Performs n_steps steps with the time step dt
+    */
+    void integrate(std::vector<Planet> &planets, double dt, int n_steps);
+
+    double time() const { return _time; }
+    IntegrationScheme scheme() const { return _scheme; }
+
+    /*
+    The fractions of dt of the kicks k_0 ... k_n and drifts d_0 ... d_n-1 of one step of the scheme
+    */
+    static void scheme_weights(IntegrationScheme scheme, std::vector<double> &kicks, std::vector<double> &drifts);
+
+    /*
+    The accelerations at the current positions, computed if they are not known yet
+    */
+    const std::vector<Eigen::Vector3d> &accelerations(const std::vector<Planet> &planets);
+
+    /*
+    Has to be called if the planets were changed outside of the integrator
+    so the stored accelerations are not used anymore
+    */
+    void invalidate_accelerations() { _accelerations_valid = false; }
+
+    /*
+    The accelerations of the last kick without computing anything, empty if they are not known
+    Together with time() this is the whole state of the integrator, see Checkpoint
+    */
+    std::vector<Eigen::Vector3d> known_accelerations() const
+    {
+        return _accelerations_valid ? _accelerations : std::vector<Eigen::Vector3d>();
+    }
+
+    /*
+    Continues at the given time, e.g. after reading a checkpoint
+    If accelerations is empty they are computed at the beginning of the next step
+    */
+    void restore(double time, std::vector<Eigen::Vector3d> accelerations);
+
+private:
+    AccelerationFunction _acceleration_function;
+    IntegrationScheme _scheme;
+
+    std::vector<double> _kicks;
+    std::vector<double> _drifts;
+
+    double _time = 0.0;
+
+    // accelerations at the current positions, valid after a step which ended with a kick
+    std::vector<Eigen::Vector3d> _accelerations;
+    bool _accelerations_valid = false;
+
+    static void _set_leap_frog_weights(const std::vector<double> &weights, std::vector<double> &kicks, std::vector<double> &drifts);
+    void _kick(std::vector<Planet> &planets, double dt);
+    void _drift(std::vector<Planet> &planets, double dt);
+};
+
+#endif
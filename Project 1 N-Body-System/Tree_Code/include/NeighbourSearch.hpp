@@ -0,0 +1,161 @@
+#ifndef NEIGHBOURSEARCH_hpp
+#define NEIGHBOURSEARCH_hpp
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <Eigen/Dense>
+#include "Node.hpp"
+#include "Parallel.hpp"
+
+/*
+Nearest neighbour and fixed radius searches on an already built tree (see Node::build)
+
+For all planets at once the queries are batched by leaf: the planets of a leaf are close together,
+so they share one walk through the tree, which only opens the nodes which could be closer than the
+current k-th neighbour of any of them. The leaves are distributed over the threads
+The planet itself is always part of its own neighbours (at distance 0), as the kernel sums need it
+The tree has to stay alive as long as the search is used
+*/
+class NeighbourSearch
+{
+public:
+    NeighbourSearch(const Node &tree, unsigned int n_threads = 0);
+
+    // the number of planets in the tree, the indices go from 0 to size() - 1 for a tree from Node::build
+    std::size_t size() const { return _size; }
+
+    /*
+    The k planets which are closest to x, sorted by distance
+    */
+    std::vector<Neighbour> nearest(const Eigen::Vector3d &x, std::size_t k) const;
+
+    /*
+    All planets within radius of x, in no particular order
+    */
+    std::vector<Neighbour> within(const Eigen::Vector3d &x, double radius) const;
+
+    /*
+    Calls function(index, neighbours, thread_index) for every planet in the tree with its k nearest
+    neighbours sorted by distance. The span is only valid during the call
+    */
+    template <typename Function>
+    void for_each_nearest(std::size_t k, Function function) const;
+
+    /*
+    The same with all neighbours within radius, in no particular order
+    */
+    template <typename Function>
+    void for_each_within(double radius, Function function) const;
+
+    /*
+    The same with its own radius for every planet, radii[index] with the index of the planet in the tree
+    (e.g. twice the smoothing lengths)
+    */
+    template <typename Function>
+    void for_each_within(const std::vector<double> &radii, Function function) const;
+
+    /*
+    The distance to the k-th nearest neighbour of every planet, e.g. as smoothing length
+    */
+    std::vector<double> kth_neighbour_distances(std::size_t k) const;
+
+    /*
+    A simple density estimate of every planet: the mass of its k nearest neighbours (itself included)
+    divided by the volume of the sphere which just contains them
+    */
+    std::vector<double> densities(std::size_t k) const;
+
+private:
+    const Node &_tree;
+    unsigned int _n_threads;
+    std::size_t _size = 0;
+
+    // the leaves in the order of the tree, so neighbouring leaves end up on the same thread
+    std::vector<const Node *> _leaves;
+
+    void _collect_leaves(const Node &node);
+
+    /*
+    One walk for a group of points, each of them gets its own heap (k nearest) or list (radius search)
+    own_leaf is the leaf the points come from, it is searched first (nullptr for a single point)
+    */
+    void _nearest(const std::vector<Eigen::Vector3d> &points, const Node *own_leaf, std::size_t k,
+                  std::vector<std::vector<Neighbour>> &heaps) const;
+    void _within(const std::vector<Eigen::Vector3d> &points, const std::vector<double> &radii,
+                 std::vector<std::vector<Neighbour>> &lists) const;
+
+    // the recursive parts of the above, bound2 is the squared distance beyond which nothing is needed
+    // and skip a leaf which was already searched
+    void _walk_nearest(const Node &node, const Node *skip, const std::vector<Eigen::Vector3d> &points,
+                       const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, std::size_t k,
+                       std::vector<std::vector<Neighbour>> &heaps, double &bound2) const;
+    void _walk_within(const Node &node, const std::vector<Eigen::Vector3d> &points, const std::vector<double> &radii2,
+                      const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, double radius2,
+                      std::vector<std::vector<Neighbour>> &lists) const;
+
+    // the positions of the planets of a leaf
+    static void _positions(const Node &leaf, std::vector<Eigen::Vector3d> &points);
+};
+
+template <typename Function>
+void NeighbourSearch::for_each_nearest(std::size_t k, Function function) const
+{
+    parallel_for(_leaves.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        std::vector<Eigen::Vector3d> points;
+        std::vector<std::vector<Neighbour>> heaps;
+        for (std::size_t l = begin; l < end; l++)
+        {
+            _positions(*_leaves[l], points);
+            _nearest(points, _leaves[l], k, heaps);
+
+            const auto &indices = _leaves[l]->leaf_indices();
+            for (std::size_t m = 0; m < indices.size(); m++)
+                function(indices[m], std::span<const Neighbour>(heaps[m]), thread);
+        }
+    }, _n_threads);
+}
+
+template <typename Function>
+void NeighbourSearch::for_each_within(double radius, Function function) const
+{
+    parallel_for(_leaves.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        std::vector<Eigen::Vector3d> points;
+        std::vector<double> radii;
+        std::vector<std::vector<Neighbour>> lists;
+        for (std::size_t l = begin; l < end; l++)
+        {
+            _positions(*_leaves[l], points);
+            radii.assign(points.size(), radius);
+            _within(points, radii, lists);
+
+            const auto &indices = _leaves[l]->leaf_indices();
+            for (std::size_t m = 0; m < indices.size(); m++)
+                function(indices[m], std::span<const Neighbour>(lists[m]), thread);
+        }
+    }, _n_threads);
+}
+
+template <typename Function>
+void NeighbourSearch::for_each_within(const std::vector<double> &radii, Function function) const
+{
+    parallel_for(_leaves.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        std::vector<Eigen::Vector3d> points;
+        std::vector<double> group_radii;
+        std::vector<std::vector<Neighbour>> lists;
+        for (std::size_t l = begin; l < end; l++)
+        {
+            const auto &indices = _leaves[l]->leaf_indices();
+            _positions(*_leaves[l], points);
+            group_radii.clear();
+            for (std::size_t index : indices)
+                group_radii.push_back(radii[index]);
+            _within(points, group_radii, lists);
+
+            for (std::size_t m = 0; m < indices.size(); m++)
+                function(indices[m], std::span<const Neighbour>(lists[m]), thread);
+        }
+    }, _n_threads);
+}
+
+#endif
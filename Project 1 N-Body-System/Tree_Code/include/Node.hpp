@@ -6,28 +6,135 @@
 #include <Eigen/Core>
 #include <vector>
 #include "Planet.hpp"
+#include "PeriodicBox.hpp"
+
+// a planet found by a search in the tree
+struct Neighbour
+{
+    std::size_t index; // the index the planet got when the tree was built
+    double distance2;  // squared distance to the query point
+};
 
 class Node
 {
 public:
     // create the function to access the below values
-    double total_mass() {return _total_mass_flag ? _total_mass : _compute_total_mass();}
-    Eigen::Vector3d com() {return _com_flag ? _com : _compute_com();}
-    Eigen::Vector3d center_position() {return _center_position_flag ? _center_position : _compute_center_position();}
-    double expansion_coefficient() {return _expansion_coefficient_flag ? _expansion_coefficient : _compute_expansion_coefficient();}
-    Eigen::Matrix3d Q() {return _Q_flag ? _Q : _compute_Q();}
+    // the geometry is set in the constructor and the multipoles in subdivide, so after the build the tree
+    // is only read and any number of threads can walk it at the same time
+    double total_mass() const {return _total_mass;}
+    Eigen::Vector3d com() const {return _com;}
+    Eigen::Vector3d center_position() const {return _center_position;}
+    double expansion_coefficient() const {return _expansion_coefficient;}
+    Eigen::Matrix3d Q() const {return _Q;}
     
+    // read access to the structure of the tree, for the searches which walk it themselves (see NeighbourSearch)
+    bool leaf() const {return is_leaf;}
+    const std::vector<Node> & child_nodes() const {return children;}
+    const std::vector<Planet> & leaf_planets() const {return planets;}
+    const std::vector<std::size_t> & leaf_indices() const {return indices;}
+    Eigen::Vector3d lower_corner() const {return diag_one.cwiseMin(diag_two);}
+    Eigen::Vector3d upper_corner() const {return diag_one.cwiseMax(diag_two);}
+
+    /**
+     * Subdivides the node into 8 child nodes
+     * \param planets The planets contained in this node, they get the indices 0, 1, ... in the leaves
+     */
+    void subdivide(const std::vector<Planet> & planets);
+
     /**
      * Subdivides the node into 8 child nodes
      * \param planets The planets contained in this node
+     * \param indices The index of each planet, which the leaves keep next to the planet (e.g. the index in the whole simulation)
      */
-    void subdivide(std::vector<Planet> & planets);
+    void subdivide(const std::vector<Planet> & planets, const std::vector<std::size_t> & indices);
 
     /**
      * Computes the acceleration on a planet due to all planets in this node
      * \param p The planet
      */
-    Eigen::Vector3d compute_acceleration(const Planet & p);
+    Eigen::Vector3d compute_acceleration(const Planet & p) const;
+
+    /**
+     * Computes the potential at the position of a planet due to all planets in this node
+     * it uses the same expansion and opening criterion as the acceleration
+     * \param p The planet
+     */
+    double compute_potential(const Planet & p) const;
+
+    /**
+     * Computes acceleration and potential in the same tree walk, which costs little more than the acceleration alone
+     * \param p The planet
+     * \param acceleration The acceleration due to this node is added to it
+     * \param potential The potential due to this node is added to it
+     */
+    void compute_acceleration_and_potential(const Planet & p, Eigen::Vector3d & acceleration, double & potential) const;
+
+    /**
+     * Gravity and the neighbours within radius in one walk, so a hydro solver does not need a second search
+     * Nodes which could contain neighbours are always opened, the others are treated as in compute_acceleration_and_potential
+     * \param p The planet
+     * \param radius The neighbours up to this distance are collected (the planet itself included)
+     * \param acceleration The acceleration due to this node is added to it
+     * \param potential The potential due to this node is added to it
+     * \param neighbours The neighbours in this node are appended to it
+     */
+    void compute_acceleration_and_neighbours(const Planet & p, double radius, Eigen::Vector3d & acceleration, double & potential, std::vector<Neighbour> & neighbours) const;
+
+    /**
+     * The short range part of the TreePM split, the kernel -G m erfc(r / 2 r_s) / r (see ParticleMesh)
+     * Nodes further away than the cutoff are not visited at all, which bounds the depth of the walk
+     * Accepted nodes only use the monopole, as the quadrupole of the split kernel is not the one of 1 / r
+     * \param p The planet
+     * \param split_radius The split radius r_s, the same as the one of the mesh
+     * \param cutoff Nodes whose box is further away than this are skipped, about 4.5 r_s
+     * \param acceleration The acceleration due to this node is added to it
+     * \param potential The potential due to this node is added to it
+     */
+    void compute_short_range_acceleration_and_potential(const Planet & p, double split_radius, double cutoff, Eigen::Vector3d & acceleration, double & potential) const;
+
+    /**
+     * Acceleration and potential in a periodic box: the nearest image of every planet plus the Ewald correction for all others
+     * The ewald correction is smooth, so it is added once for every node of about a quarter of the box size
+     * The tree has to be built from the wrapped positions (see PeriodicBox::wrap)
+     * \param p The planet
+     * \param box The periodic box with the tabulated Ewald correction
+     * \param acceleration The acceleration due to this node and its images is added to it
+     * \param potential The potential due to this node and its images is added to it
+     */
+    void compute_periodic_acceleration_and_potential(const Planet & p, const PeriodicBox & box, Eigen::Vector3d & acceleration, double & potential) const;
+
+    /**
+     * Acceleration and potential at a group of points which are close together, with one walk for all of them
+     * A node which is far enough away from the whole box around the points is accepted for all of them at once,
+     * otherwise the points which are far enough on their own take it and only the others open it.
+     * Every point so gets the same result as with its own walk. Points on a planet do not feel that planet
+     * \param points The positions, e.g. probes which are not planets at all
+     * \param lower The lower corner of the box around the points
+     * \param upper The upper corner of the box around the points
+     * \param accelerations The accelerations due to this node are added to them, one for every point
+     * \param potentials The potentials due to this node are added to them, one for every point
+     */
+    void compute_field(const std::vector<Eigen::Vector3d> & points, const Eigen::Vector3d & lower, const Eigen::Vector3d & upper, std::vector<Eigen::Vector3d> & accelerations, std::vector<double> & potentials) const;
+
+    /**
+     * Builds the whole tree for the given planets
+     * the root node is the smallest cube centered at the origin which contains all planets
+     * \param planets The planets to put into the tree
+     * \param limit_ The maximum number of planets in a leaf node
+     * \param G_ The gravitational constant
+     * \param theta_ The opening angle for the Barnes-Hut criterion
+     * \param softening_ The plummer softening used for the direct interactions in the leaves
+     * \param quadrupole_ Whether accepted nodes add their quadrupole to the monopole
+     */
+    static Node build(const std::vector<Planet> & planets, int limit_, double G_, double theta_, double softening_ = 0.0, bool quadrupole_ = true);
+
+    /**
+     * Changes the opening angle and the expansion of the whole tree, which do not change its structure
+     * so one tree can be walked with several settings (see TreeTuner). Not while other threads walk it
+     * \param theta_ The opening angle for the Barnes-Hut criterion
+     * \param quadrupole_ Whether accepted nodes add their quadrupole to the monopole
+     */
+    void set_opening(double theta_, bool quadrupole_);
 
     /**
      * Constructor for the Node class
@@ -37,10 +144,15 @@ public:
      * \param depth_ The depth of the node in the tree
      * \param G_ The gravitational constant
      * \param theta_ The opening angle for the Barnes-Hut criterion
+     * \param softening_ The plummer softening used for the direct interactions in the leaves
+     * \param quadrupole_ Whether accepted nodes add their quadrupole to the monopole, without it the walk is cheaper but needs a smaller theta
      */
-    Node(Eigen::Vector3d dia1, Eigen::Vector3d dia2, int limit_, int depth_, double G_, double theta_)
-        : diag_one(dia1), diag_two(dia2), limit(limit_), depth(depth_), is_leaf(true), G(G_), theta(theta_)
-    {}
+    Node(Eigen::Vector3d dia1, Eigen::Vector3d dia2, int limit_, int depth_, double G_, double theta_, double softening_ = 0.0, bool quadrupole_ = true)
+        : diag_one(dia1), diag_two(dia2), limit(limit_), depth(depth_), is_leaf(true), G(G_), theta(theta_), softening(softening_), quadrupole(quadrupole_)
+    {
+        _compute_center_position();
+        _compute_expansion_coefficient();
+    }
 
 private:
     // better internal properties
@@ -53,33 +165,38 @@ private:
 
     double G;
     double theta;
+    double softening;
+    bool quadrupole;
+
+    // planets which are at the same position would be subdivided forever
+    static constexpr int max_depth = 64;
 
     std::vector<Planet> planets;
+    std::vector<std::size_t> indices;
     std::vector<Node> children;
 
 
     // internal properties
-    double _total_mass;
-    Eigen::Vector3d _com;
+    double _total_mass = 0.0;
+    Eigen::Vector3d _com = Eigen::Vector3d::Zero();
     Eigen::Vector3d _center_position;
     double _expansion_coefficient;
-    Eigen::Matrix3d _Q;
-
-
-    // create flags for once computed values
-    bool _total_mass_flag = false;
-    bool _com_flag = false;
-    bool _center_position_flag = false;
-    bool _expansion_coefficient_flag = false;
-    bool _Q_flag = false;
+    Eigen::Matrix3d _Q = Eigen::Matrix3d::Zero();
 
 
     // create the functions, which are needed to compute these values
+    // the ones of the multipoles need the children to be complete
     double _compute_total_mass();
     Eigen::Vector3d _compute_com();
     Eigen::Vector3d _compute_center_position();
     double _compute_expansion_coefficient();
     Eigen::Matrix3d _compute_Q();
+
+    // the walk of compute_field, only for the points in active, the box is the one around them
+    void _field_walk(const std::vector<Eigen::Vector3d> & points, const std::vector<std::size_t> & active, const Eigen::Vector3d & lower, const Eigen::Vector3d & upper, std::vector<Eigen::Vector3d> & accelerations, std::vector<double> & potentials) const;
+
+    // images_added is true below the node which already added the ewald correction
+    void _periodic_walk(const Planet & p, const PeriodicBox & box, Eigen::Vector3d & acceleration, double & potential, bool images_added) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef PAIRCOUNTER_hpp
+#define PAIRCOUNTER_hpp
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+
+/*
+Counts the pairs of planets in logarithmic bins of their distance between r_min and r_max,
+for the two point correlation function
+
+Instead of looking at every pair, two nodes are compared at a time (dual tree): if the smallest and
+the largest distance between their boxes fall into the same bin, all n_a * n_b pairs are added at once,
+if they lie outside of all bins nothing is added. Only the other node pairs are split further
+The node pairs of the first few levels are distributed over the threads, each with its own histogram
+*/
+class PairCounter
+{
+public:
+    PairCounter(double r_min, double r_max, std::size_t n_bins, unsigned int n_threads = 0);
+
+    /*
+    The number of distinct pairs within the planets of one tree (auto correlation)
+    */
+    const std::vector<double> &count(const Node &tree);
+
+    /*
+    The number of pairs with one planet from each tree (cross correlation)
+    */
+    const std::vector<double> &count(const Node &tree_a, const Node &tree_b);
+
+    const std::vector<double> &counts() const { return _counts; }
+
+    // the n_bins + 1 edges of the bins
+    const std::vector<double> &bin_edges() const { return _edges; }
+
+    /*
+    The Landy & Szalay estimator xi = (DD - 2 DR + RR) / RR, with the pair counts normalised by the number of pairs
+    */
+    static std::vector<double> landy_szalay(const std::vector<double> &dd, const std::vector<double> &dr, const std::vector<double> &rr,
+                                            std::size_t n_data, std::size_t n_random);
+
+    /*
+    The correlation function of data, compared to the uniform randoms, with trees of limit planets per leaf
+    */
+    std::vector<double> correlation_function(const std::vector<Planet> &data, const std::vector<Planet> &randoms, int limit = 8);
+
+    /*
+    Writes one line per bin with its edges and the last counts, separated by ;
+    */
+    void export_to_file(const std::string &filename) const;
+
+private:
+    std::size_t _n_bins;
+    unsigned int _n_threads;
+
+    std::vector<double> _edges;
+    std::vector<double> _edges2; // squared, as the distances are compared squared
+
+    // for each thread one histogram after the other
+    std::vector<double> _histograms;
+    std::vector<double> _counts;
+
+    // the tree in one array, the children of a cell follow each other
+    // the boxes are the smallest ones around the planets, which prune better than the cubes of the octree
+    struct Cell
+    {
+        Eigen::Vector3d lower;
+        Eigen::Vector3d upper;
+        std::size_t n_planets;
+        std::size_t first;      // the first child, or the first position of a leaf
+        std::size_t n_children; // 0 for a leaf
+    };
+    struct FlatTree
+    {
+        std::vector<Cell> cells;
+        std::vector<Eigen::Vector3d> positions;
+    };
+
+    // a pair of cells still to count, same if both are the same cell of the same tree
+    struct Task
+    {
+        std::size_t a;
+        std::size_t b;
+        bool same;
+    };
+
+    static FlatTree _flatten(const Node &tree);
+    static void _flatten(const Node &node, std::size_t index, FlatTree &flat);
+
+    const std::vector<double> &_count(const FlatTree &tree_a, const FlatTree &tree_b, bool same);
+
+    /*
+    Counts the pairs of two cells into histogram, if split is given the pairs of their children
+    are appended to it instead of counted right away
+    */
+    void _count_pair(const FlatTree &tree_a, const FlatTree &tree_b, const Task &task, double *histogram, std::vector<Task> *split) const;
+
+    // the bin of a squared distance, -1 below r_min and n_bins from r_max on
+    long _bin(double distance2) const;
+};
+
+#endif
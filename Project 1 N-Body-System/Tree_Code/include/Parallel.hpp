@@ -0,0 +1,45 @@
+#ifndef PARALLEL_hpp
+#define PARALLEL_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+The number of threads to use if nothing else is given, at least 1
+*/
+inline unsigned int default_thread_count()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/*
+Splits the indices 0..n-1 into n_threads contiguous ranges and calls
+function(begin, end, thread_index) for each of them on its own thread
+The calling thread does the first range itself, so with one thread nothing is started
+Each thread gets its own thread_index, so it can write into its own buffers without locking
+*/
+template <typename Function>
+void parallel_for(std::size_t n, Function function, unsigned int n_threads = 0)
+{
+    if (n_threads == 0)
+        n_threads = default_thread_count();
+    n_threads = static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(n_threads, n)));
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (unsigned int t = 1; t < n_threads; t++)
+    {
+        std::size_t begin = n * t / n_threads;
+        std::size_t end = n * (t + 1) / n_threads;
+        threads.emplace_back(function, begin, end, t);
+    }
+
+    function(std::size_t(0), n / n_threads, 0u);
+
+    for (auto &thread : threads)
+        thread.join();
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef PARTICLEMESH_hpp
+#define PARTICLEMESH_hpp
+
+#include <complex>
+#include <span>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "FFT.hpp"
+
+enum class MassAssignment
+{
+    cic, // cloud in cell, every planet is spread over the 2^3 closest mesh points
+    tsc  // triangular shaped cloud, 3^3 mesh points, smoother but more expensive
+};
+
+/*
+The long range part of the TreePM split of the gravitational force
+The potential -G m / r is split into a long range part -G m erf(r / 2 r_s) / r, which is smooth
+and is computed here on a mesh, and a short range part -G m erfc(r / 2 r_s) / r, which drops to
+zero after a few r_s and is left to the tree (see Node::compute_short_range_acceleration_and_potential)
+
+The mesh is a cube with n_mesh^3 points around the planets. For isolated systems the mass is put
+into a mesh of twice the size, filled up with zeros, and convolved with the long range kernel
+by FFT (Hockney & Eastwood), so there are no periodic images
+*/
+class ParticleMesh
+{
+public:
+    /**
+     * \param n_mesh The number of mesh points per side, a power of 2
+     * \param G The gravitational constant
+     * \param split The split radius r_s in units of the mesh spacing
+     * \param assignment How the mass is distributed onto the mesh
+     */
+    ParticleMesh(std::size_t n_mesh, double G, double split = 1.25, MassAssignment assignment = MassAssignment::cic, unsigned int n_threads = 0);
+
+    /*
+    Adds the long range accelerations and potentials of all planets onto the given ones
+    The mesh grows with the planets, the kernel is only transformed again if it had to grow
+    */
+    void add_long_range(std::span<const Planet> planets, std::vector<Eigen::Vector3d> &accelerations, std::vector<double> &potentials);
+
+    // the split radius of the last call, the tree has to use the same one
+    double split_radius() const { return _split * _spacing; }
+    double spacing() const { return _spacing; }
+
+private:
+    std::size_t _n;
+    double _G;
+    double _split;
+    MassAssignment _assignment;
+    unsigned int _n_threads;
+
+    FFT _fft; // of the padded mesh with 2 n points per side
+
+    double _spacing = 0.0;
+    Eigen::Vector3d _corner = Eigen::Vector3d::Zero();
+
+    std::vector<std::complex<double>> _kernel; // transformed long range kernel on the padded mesh
+    std::vector<std::complex<double>> _padded;
+    std::vector<double> _potential;            // on the n^3 mesh
+    std::vector<Eigen::Vector3d> _acceleration; // on the n^3 mesh
+
+    // finds the mesh points and weights of one planet, returns the number of points per axis
+    int _weights(const Eigen::Vector3d &position, long index[3][3], double weight[3][3]) const;
+
+    bool _fit_mesh(std::span<const Planet> planets);
+    void _transform_kernel();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef PERIODICBOX_hpp
+#define PERIODICBOX_hpp
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+/*
+A cubic box of side L centered at the origin, which is repeated infinitely in all directions
+
+Every planet then feels all images of every other planet. The nearest image is computed directly,
+all others are added with the Ewald correction: the difference between the periodic potential
+(with the usual uniform background, so the sum converges) and - G m / r of the nearest image
+
+The correction is smooth, so it is tabulated once on a grid for the unit box and interpolated
+Because it scales as G m / L (potential) and G m / L^2 (force), one table serves every box size
+The Ewald sums for the table take a few seconds, so it is cached in a file and only recomputed
+if the file is missing or was made with another grid, splitting or number of images and wave vectors
+*/
+class PeriodicBox
+{
+public:
+    /*
+    n_grid is the number of grid intervals of the table in [0, L/2] along each axis
+    an empty cache_file computes the table without saving it
+    */
+    PeriodicBox(double box_size, const std::string &cache_file = "", int n_grid = 32, unsigned int n_threads = 0);
+
+    double size() const { return _L; }
+
+    // moves a position back into [-L/2, L/2)
+    Eigen::Vector3d wrap(const Eigen::Vector3d &position) const;
+
+    // the shortest of all separation vectors between the images
+    Eigen::Vector3d minimum_image(const Eigen::Vector3d &r) const;
+
+    /*
+    The Ewald correction for a separation r (already the minimum image) per unit G m
+    force is added to the acceleration and potential to the potential, both with the factor G m
+    */
+    void correction(const Eigen::Vector3d &r, Eigen::Vector3d &force, double &potential) const;
+
+private:
+    double _L;
+    int _n;
+
+    // force and potential of the unit box on (n + 1)^3 points in [0, 1/2]^3, x is the slowest index
+    // they are kept together, as every lookup needs all four. By symmetry the force is odd
+    // and the potential even in every coordinate
+    std::vector<Eigen::Vector4d> _table;
+
+    void _compute_table(unsigned int n_threads);
+    bool _load_table(const std::string &filename);
+    bool _save_table(const std::string &filename) const;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef RADIALPROFILE_hpp
+#define RADIALPROFILE_hpp
+
+#include <span>
+#include <string>
+#include <vector>
+#include "Planet.hpp"
+
+// one spherical shell of the profile, all velocities are mass weighted
+struct ProfileBin
+{
+    double r_inner;
+    double r_outer;
+    double r_center; // geometric mean of the two radii, the middle of the bin on a log scale
+
+    std::size_t n_planets;
+    double mass;
+    double density;           // mass / volume of the shell
+    double enclosed_mass;     // mass inside r_outer, including everything inside of the first bin
+    double circular_velocity; // sqrt(G M(<r_outer) / r_outer)
+
+    double mean_radial_velocity;
+    double sigma_r;
+    double sigma_theta;
+    double sigma_phi;
+    double anisotropy; // beta = 1 - (sigma_theta^2 + sigma_phi^2) / (2 sigma_r^2)
+
+    // the same quantities for the hernquist model
+    // the density is averaged over the shell, so it can be compared with the binned density directly
+    double hq_density;
+    double hq_enclosed_mass;
+    double hq_circular_velocity;
+};
+
+/*
+Bins the planets into logarithmic spherical shells around the origin in one parallel pass
+Every thread fills its own histogram, which are added up at the end, so no locks are needed
+and the result does not depend on the order in which the threads finish
+Planets inside r_min only count for the enclosed mass, planets outside r_max are ignored
+*/
+class RadialProfile
+{
+public:
+    RadialProfile(double r_min, double r_max, std::size_t n_bins, unsigned int n_threads = 0);
+
+    /**
+     * Computes the profile of the planets
+     * \param G The gravitational constant
+     * \param hq_total_mass The total mass of the hernquist model to compare with
+     * \param hq_scale_factor The scale length a of the hernquist model
+     */
+    const std::vector<ProfileBin> &compute(std::span<const Planet> planets, double G, double hq_total_mass, double hq_scale_factor);
+
+    const std::vector<ProfileBin> &bins() const { return _bins; }
+
+    /*
+    Writes one line per bin with all quantities, separated by ;
+    */
+    void export_to_file(const std::string &filename) const;
+
+private:
+    double _r_min;
+    double _r_max;
+    std::size_t _n_bins;
+    unsigned int _n_threads;
+
+    double _log_r_min;
+    double _bins_per_log;
+
+    // the sums per bin, for each thread one histogram after the other
+    struct Accumulator
+    {
+        std::size_t n = 0;
+        double mass = 0;
+        double v_r = 0;
+        double v_r2 = 0;
+        double v_theta = 0;
+        double v_theta2 = 0;
+        double v_phi = 0;
+        double v_phi2 = 0;
+
+        Accumulator &operator+=(const Accumulator &other);
+    };
+    std::vector<Accumulator> _histograms;
+
+    // the mass inside of r_min, per thread
+    std::vector<double> _inner_mass;
+
+    std::vector<ProfileBin> _bins;
+};
+
+#endif
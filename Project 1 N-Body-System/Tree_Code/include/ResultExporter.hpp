@@ -2,42 +2,58 @@
 #define RESULTEXPORTER_hpp
 
 
-#include <iostream>
-#include <fstream>
+#include <span>
+#include <string>
 #include <vector>
 #include <Eigen/Dense>
 
+enum class ExportFormat
+{
+    csv,    // x,y,z,fx,fy,fz per line, readable with np.genfromtxt
+    binary, // raw doubles in the byte order of this machine, N rows of 6 values
+    npy     // the same as binary with a numpy header, np.load(..., mmap_mode='r') works directly
+};
+
 class ResultExporter
 {
 public:
-    static void export_force_computation(std::vector<Eigen::Vector3d> positions, std::vector<Eigen::Vector3d> forces, std::string filename)
+    /*
+    The exporter keeps its buffer between the exports, so for repeated exports
+    (e.g. one per snapshot) nothing has to be allocated anymore
+    precision is the number of significant digits of the csv output (at most 17, more digits say nothing about a double),
+    a negative value gives the shortest representation which reads back exactly
+    */
+    ResultExporter(ExportFormat format = ExportFormat::csv, int precision = 6, std::size_t buffer_size = std::size_t(1) << 20);
+
+    /*
+    Writes the positions and forces to the file, returns false if it did not work
+    the spans only look at the data, so vectors, arrays or parts of them can be passed without copying
+    */
+    bool write_force_computation(std::span<const Eigen::Vector3d> positions, std::span<const Eigen::Vector3d> forces, const std::string & filename);
+
+    /*
+    Exports as csv with 6 significant digits, the same format as the files in output/data
+    */
+    static void export_force_computation(std::span<const Eigen::Vector3d> positions, std::span<const Eigen::Vector3d> forces, const std::string & filename)
     {
-        // quickly check that both vectors have the same length
-        if(positions.size() != forces.size())
-        {
-            std::cout << "export for file " << filename << " did not work, as positions and forces have not same dimension";
-            std::cout << "positions has dimension " << positions.size() << ", forces has dimension " << forces.size() << "\n";
-            return;
-        }
-
-
-        // here we can actually do the export
-        std::ofstream file(filename);
-        if(file.is_open())
-        {
-            for(int i = 0; i < positions.size(); i++)
-            {
-                file << positions[i](0) << "," << positions[i](1) << "," << positions[i](2) << ",";
-                file << forces[i](0) << "," << forces[i](1) << "," << forces[i](2) << "\n";
-            }
-        }
-
-        file.close();
+        ResultExporter exporter;
+        exporter.write_force_computation(positions, forces, filename);
     }
+
+    /*
+    The header numpy expects in front of an array with the given shape, type is the numpy type
+    without the byte order, e.g. "f8" for doubles and "f4" for floats
+    */
+    static std::string npy_header(std::size_t rows, std::size_t columns, const std::string &type = "f8");
+
+private:
+    ExportFormat _format;
+    int _precision;
+    std::vector<char> _buffer;
 };
 
 
 
 
 
-#endif //RESULTEXPORTER_hpp
\ No newline at end of file
+#endif //RESULTEXPORTER_hpp
@@ -0,0 +1,76 @@
+#ifndef SCFSOLVER_hpp
+#define SCFSOLVER_hpp
+
+#include <span>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+
+/*
+Self consistent field method of Hernquist & Ostriker (1992)
+The density and the potential are expanded in a basis whose lowest order is exactly the hernquist model,
+phi_nl(r) = - s^l / (1 + s)^(2l+1) C_n^(2l+3/2)(xi) with s = r / a and xi = (s - 1) / (s + 1),
+times the spherical harmonics P_l^m(cos theta) cos(m phi) and sin(m phi)
+
+The coefficients are a sum over all planets, so they are found in one O(N) pass, after which
+potential and acceleration at any point only depend on the coefficients, again O(N) for all planets
+For halos close to the hernquist model a few radial (n_max) and angular (l_max) terms are enough
+The expansion is around the origin, where our halo sits
+*/
+class SCFSolver
+{
+public:
+    SCFSolver(int n_max, int l_max, double scale_length, double G, unsigned int n_threads = 0);
+
+    /*
+    Computes the expansion coefficients of the planets, every thread sums up its own set
+    */
+    void compute_coefficients(std::span<const Planet> planets);
+
+    /**
+     * Evaluates the expansion at a position, the coefficients have to be computed before
+     * \param position The position
+     * \param acceleration The acceleration at the position is added to it
+     * \param potential The potential at the position is added to it
+     */
+    void compute_acceleration_and_potential(const Eigen::Vector3d &position, Eigen::Vector3d &acceleration, double &potential) const;
+
+    /*
+    Computes the coefficients and then the accelerations of all planets,
+    the same signature as the force function of the NBodyIntegrator
+    */
+    std::vector<Eigen::Vector3d> compute_accelerations(const std::vector<Planet> &planets);
+
+    // the potentials of the planets of the last compute_accelerations
+    const std::vector<double> &potentials() const { return _potentials; }
+
+    // the coefficients of cos(m phi) and sin(m phi), A(n, l, m) = cos_coefficients()[_index(n, l, m)]
+    const std::vector<double> &cos_coefficients() const { return _A; }
+    const std::vector<double> &sin_coefficients() const { return _B; }
+
+private:
+    int _n_max;
+    int _l_max;
+    double _a;
+    double _G;
+    unsigned int _n_threads;
+
+    // (2 - delta_m0) N_lm / I_nl, the constant factor of every coefficient
+    std::vector<double> _normalisation;
+
+    std::vector<double> _A;
+    std::vector<double> _B;
+
+    std::vector<double> _potentials;
+
+    std::size_t _index(int n, int l, int m) const { return (static_cast<std::size_t>(n) * (_l_max + 1) + l) * (_l_max + 1) + m; }
+    std::size_t _n_coefficients() const { return _index(_n_max + 1, 0, 0); }
+
+    // phi_nl(s) and d phi_nl / ds for all n and l, stored as [l * (n_max + 1) + n]
+    void _radial_functions(double s, double *phi, double *dphi) const;
+
+    // P_l^m(x) and (1 - x^2) dP_l^m / dx for all l >= m, stored as [l * (l_max + 1) + m]
+    void _legendre(double x, double *p, double *dp) const;
+};
+
+#endif
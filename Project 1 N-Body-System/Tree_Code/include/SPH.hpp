@@ -0,0 +1,94 @@
+#ifndef SPH_hpp
+#define SPH_hpp
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+
+struct SPHSettings
+{
+    double gamma = 5.0 / 3.0;   // adiabatic index of the ideal gas
+    double n_neighbours = 50;   // the smoothing length is chosen so about this many neighbours are inside of 2 h
+    double alpha = 1.0;         // linear term of the artificial viscosity
+    double beta = 2.0;          // quadratic term of the artificial viscosity
+    double tolerance = 1e-5;    // relative accuracy of the smoothing lengths
+    int max_iterations = 30;    // of the newton iteration for the smoothing lengths
+    double courant = 0.3;
+};
+
+/*
+The gas in SoA form: every quantity in its own array, so the loops over the neighbours
+only read the arrays they actually need
+Particle i of the gas is planet i of planets(), which is what the tree has to be built from
+*/
+struct GasParticles
+{
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;
+    std::vector<double> mass;
+    std::vector<double> u; // internal energy per mass
+
+    // computed by the SPHSolver
+    std::vector<double> h;           // smoothing length, the kernel reaches to 2 h
+    std::vector<double> density;
+    std::vector<double> pressure;
+    std::vector<double> sound_speed;
+    std::vector<double> omega;       // the correction for the variable smoothing lengths (grad h term)
+    std::vector<double> ax, ay, az;  // hydro (and gravity) acceleration
+    std::vector<double> du_dt;
+    std::vector<double> potential;   // gravitational potential, if gravity was computed
+
+    std::size_t size() const { return x.size(); }
+    void resize(std::size_t n);
+
+    Eigen::Vector3d position(std::size_t i) const { return Eigen::Vector3d(x[i], y[i], z[i]); }
+
+    std::vector<Planet> planets() const;
+    static GasParticles from_planets(const std::vector<Planet> &planets, double u);
+};
+
+/*
+Smoothed particle hydrodynamics with the cubic spline kernel, following Price (2012):
+the smoothing lengths solve rho(h) h^3 = m (eta)^3 with newton iterations, the forces include the
+grad h terms and the artificial viscosity of Monaghan, so momentum and energy are conserved
+
+The neighbours come from the same octree as gravity, with gravity the force loop even finds them
+in the gravity walk itself (see Node::compute_acceleration_and_neighbours)
+*/
+class SPHSolver
+{
+public:
+    SPHSolver(const SPHSettings &settings = SPHSettings(), unsigned int n_threads = 0);
+
+    const SPHSettings &settings() const { return _settings; }
+
+    /*
+    Smoothing lengths, densities, omega, pressures and sound speeds of all particles
+    gas.h is used as first guess if it was computed before
+    */
+    void compute_density(GasParticles &gas, const Node &tree) const;
+
+    /*
+    Accelerations and du/dt, compute_density has to be called before
+    With gravity = true the accelerations and potentials due to the tree are added (with its G, theta and softening)
+    */
+    void compute_forces(GasParticles &gas, const Node &tree, bool gravity) const;
+
+    /*
+    The largest stable time step, from the courant condition and the accelerations
+    */
+    double timestep(const GasParticles &gas) const;
+
+private:
+    SPHSettings _settings;
+    unsigned int _n_threads;
+    double _eta; // h = eta (m / rho)^(1/3)
+
+    // newton iterations for the smoothing length of particle i with the given candidates, false if 2 h grew beyond radius
+    bool _solve_smoothing_length(GasParticles &gas, std::size_t i, std::span<const Neighbour> candidates, double radius) const;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef SNAPSHOTARCHIVE_hpp
+#define SNAPSHOTARCHIVE_hpp
+
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+/*
+A file which holds many snapshots of the same particles, compressed without any loss
+Every snapshot consists of a fixed number of fields (e.g. positions and forces) with one
+3d vector per particle, which are stored as columns (all x, then all y, ...)
+
+Every value is predicted, either by the same value in the previous snapshot or by the
+linear extrapolation of the last two snapshots, and only the XOR of the bits of the value
+and of the better prediction is stored. Values which change little have a lot of leading
+zero bytes in the XOR, which are left out (the same idea as the FPC compressor by Burtscher)
+Each value needs 4 bits for the predictor and the number of stored bytes plus the stored bytes
+
+Every keyframe_interval snapshots a keyframe is written, which only depends on itself,
+so reading any snapshot only needs to decode the snapshots since the last keyframe
+The index with the position of every snapshot is at the end of the file
+*/
+
+class SnapshotWriter
+{
+public:
+    SnapshotWriter(const std::string &filename, std::size_t n_particles, std::size_t n_fields, std::size_t keyframe_interval = 16);
+
+    // writes the index, if close was not called before
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    bool is_open() const { return _file.is_open(); }
+
+    /*
+    Appends one snapshot, fields has to contain n_fields spans with n_particles entries each
+    */
+    bool append(double time, std::initializer_list<std::span<const Eigen::Vector3d>> fields);
+
+    /*
+    Writes the index and closes the file
+    */
+    void close();
+
+    std::size_t n_frames() const { return _index.size(); }
+    std::uint64_t bytes_written() const { return _offset; }
+
+private:
+    struct IndexEntry
+    {
+        std::uint64_t offset;
+        std::uint64_t size;
+        double time;
+    };
+
+    std::ofstream _file;
+    std::size_t _n_particles;
+    std::size_t _n_fields;
+    std::size_t _keyframe_interval;
+
+    // the last two snapshots in column order, needed for the predictions
+    std::vector<double> _current;
+    std::vector<double> _previous;
+    std::vector<double> _previous2;
+
+    // the encoded snapshot, reused for every snapshot
+    std::vector<std::uint8_t> _codes;
+    std::vector<std::uint8_t> _residuals;
+
+    std::vector<IndexEntry> _index;
+    std::uint64_t _offset = 0;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(const std::string &filename);
+
+    bool is_open() const { return _file.is_open(); }
+
+    std::size_t n_frames() const { return _index.size(); }
+    std::size_t n_particles() const { return _n_particles; }
+    std::size_t n_fields() const { return _n_fields; }
+    double time(std::size_t frame) const { return _index[frame].time; }
+
+    /*
+    Reads the snapshot with the given number, fields is resized to n_fields vectors of n_particles
+    Snapshots after the last one read are decoded incrementally, everything else starts at the last keyframe
+    */
+    bool read(std::size_t frame, std::vector<std::vector<Eigen::Vector3d>> &fields);
+
+private:
+    struct IndexEntry
+    {
+        std::uint64_t offset;
+        std::uint64_t size;
+        double time;
+    };
+
+    std::ifstream _file;
+    std::size_t _n_particles = 0;
+    std::size_t _n_fields = 0;
+    std::size_t _keyframe_interval = 1;
+    std::vector<IndexEntry> _index;
+
+    // the decoded state, so reading the snapshots one after another does not start at the keyframe again
+    std::vector<double> _current;
+    std::vector<double> _previous;
+    std::vector<double> _previous2;
+    std::size_t _decoded_frame = SIZE_MAX;
+
+    std::vector<std::uint8_t> _encoded;
+
+    bool _decode(std::size_t frame);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef TRACERINTEGRATOR_hpp
+#define TRACERINTEGRATOR_hpp
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "SCFSolver.hpp"
+#include "NBodyIntegrator.hpp"
+
+/*
+Massless test particles in SoA form, every coordinate in its own array
+*/
+struct Tracers
+{
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;
+
+    std::size_t size() const { return x.size(); }
+    void resize(std::size_t n);
+
+    Eigen::Vector3d position(std::size_t i) const { return Eigen::Vector3d(x[i], y[i], z[i]); }
+    Eigen::Vector3d velocity(std::size_t i) const { return Eigen::Vector3d(vx[i], vy[i], vz[i]); }
+
+    // the positions and velocities of the planets, their masses are not needed
+    static Tracers from_planets(const std::vector<Planet> &planets);
+};
+
+/*
+Integrates tracers in a potential which does not change, e.g. the hernquist model or a frozen tree
+or SCF expansion of the initial conditions. Nothing is rebuilt during the integration
+
+The tracers do not feel each other, so they are cut into blocks which are integrated over all steps
+one after the other: a block is copied into buffers of its thread and stays in the cache for the whole
+integration, and the threads never have to wait for each other. The kicks and drifts are simple loops
+over the SoA arrays of a block, which the compiler turns into SIMD instructions. The hernquist kernel
+works on four tracers at a time in Eigen arrays, since the compiler does not vectorize a loop with std::sqrt
+*/
+class TracerIntegrator
+{
+public:
+    // the accelerations of n tracers at x, y, z, written to ax, ay, az
+    // it is called from several threads at once, each with its own block
+    using BlockAcceleration = std::function<void(std::size_t n, const double *x, const double *y, const double *z, double *ax, double *ay, double *az)>;
+
+    /*
+    With spatial_blocks the blocks are taken along the morton curve, so the tracers of a block are close together,
+    which lets them share the walks of frozen_tree. It costs a sort at the beginning of every integrate
+    */
+    TracerIntegrator(BlockAcceleration acceleration, IntegrationScheme scheme, std::size_t block_size = 512,
+                     bool spatial_blocks = false, unsigned int n_threads = 0);
+
+    /*
+    The analytic hernquist model, M(<r) = M r^2 / (r + a)^2
+    */
+    static BlockAcceleration hernquist(double mass, double scale_length, double G);
+
+    /*
+    The field of a tree which is not rebuilt, evaluated with one walk per block (see Node::compute_field)
+    The tree has to stay alive as long as the integrator is used
+    */
+    static BlockAcceleration frozen_tree(const Node &tree);
+
+    /*
+    The field of an SCF expansion whose coefficients were already computed
+    The solver has to stay alive as long as the integrator is used
+    */
+    static BlockAcceleration frozen_scf(const SCFSolver &scf);
+
+    /*
+    Performs n_steps steps with the time step dt for all tracers
+    */
+    void integrate(Tracers &tracers, double dt, int n_steps);
+
+    double time() const { return _time; }
+
+private:
+    BlockAcceleration _acceleration;
+    std::size_t _block_size;
+    bool _spatial_blocks;
+    unsigned int _n_threads;
+
+    std::vector<double> _kicks;
+    std::vector<double> _drifts;
+
+    double _time = 0.0;
+};
+
+#endif
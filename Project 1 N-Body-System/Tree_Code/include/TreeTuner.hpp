@@ -0,0 +1,70 @@
+#ifndef TREETUNER_hpp
+#define TREETUNER_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+
+// one setting of the tree and how it did on the sample
+struct TreeConfiguration
+{
+    double theta = 0.5;
+    int limit = 10;
+    bool quadrupole = true;
+
+    double error = 0.0;      // 99th percentile of |a_tree - a_direct| / |a_direct|, the upper end of its 95% interval from the sample
+    double build_time = 0.0; // in ms
+    double walk_time = 0.0;  // in ms, estimated for all planets from the walks of the sample
+};
+
+/*
+Finds the opening angle, leaf size and expansion (monopole or monopole + quadrupole) which reach
+a given 99th percentile of the relative force error in the least time on this machine
+
+The error is measured on a sample of the planets, stratified in the distance to the center of mass,
+whose direct accelerations cost O(k N) once. For every leaf size one tree is built, and for both
+expansions the largest theta which still reaches the target is found by bisection. The fastest of
+these wins, timed as the build plus the walks of all planets (estimated from the walks of the sample)
+
+The result is cached in a text file, one line per data set, target and number of threads,
+so a second run with the same initial conditions on the same machine does not tune again
+*/
+class TreeTuner
+{
+public:
+    TreeTuner(double target_error, double G = 1.0, double softening = 0.0, std::size_t n_samples = 1000, unsigned int n_threads = 0);
+
+    TreeConfiguration tune(const std::vector<Planet> &planets, const std::string &cache_file = "");
+
+    // every leaf size and expansion of the last tune with the theta found for it, empty if it came from the cache
+    const std::vector<TreeConfiguration> &candidates() const { return _candidates; }
+
+private:
+    double _target_error;
+    double _G;
+    double _softening;
+    std::size_t _n_samples;
+    unsigned int _n_threads;
+
+    std::vector<TreeConfiguration> _candidates;
+
+    std::vector<std::size_t> _draw_samples(const std::vector<Planet> &planets) const;
+    std::vector<Eigen::Vector3d> _direct(const std::vector<Planet> &planets, const std::vector<std::size_t> &samples) const;
+
+    // the 99th percentile of the relative error with the current opening of the tree (upper end of its confidence interval)
+    double _error(const Node &tree, const std::vector<Planet> &planets, const std::vector<std::size_t> &samples, const std::vector<Eigen::Vector3d> &exact) const;
+
+    // the time in ms of the walks of all samples, the fastest of a few repetitions
+    double _walk_time(const Node &tree, const std::vector<Planet> &planets, const std::vector<std::size_t> &samples) const;
+
+    // FNV-1a of the planets and of everything else the result depends on, apart from the hardware
+    std::uint64_t _fingerprint(const std::vector<Planet> &planets) const;
+    bool _load(const std::string &filename, std::uint64_t fingerprint, TreeConfiguration &configuration) const;
+    void _save(const std::string &filename, std::uint64_t fingerprint, const TreeConfiguration &configuration) const;
+};
+
+#endif
@@ -1,9 +1,13 @@
 #ifndef UNIVERSE_hpp
 #define UNIVERSE_hpp
 
+#include <ranges>
+#include <utility>
 #include <vector>
 #include <Eigen/Dense>
 #include "Planet.hpp"
+#include "RadialProfile.hpp"
+#include "PeriodicBox.hpp"
 
 class Universe
 {
@@ -12,22 +16,31 @@ private:
     double _total_mass;
     double _scale_factor;
 
-    void _compute_magnitudes();
-    void _compute_half_mass_radius();
-    void _relist_positions();
+    // the radii of all planets in increasing order and the mass inside of them
+    // cumulative_mass of entry i is the mass of the planets 0..i of the sorted list
+    struct RadiusEntry
+    {
+        double radius;
+        double cumulative_mass;
+    };
+    std::vector<RadiusEntry> _radius_index;
+
+    void _build_radius_index();
 
 public:
+    // the only copy of the planets, everything else is computed from them
     std::vector<Planet> _planets;
-    std::vector<Eigen::Vector3d> _positions;
-    std::vector<double> _magnitudes;
 
-    Universe(const std::vector<Planet> planets) : _planets(planets)
+    /*
+    Takes the planets by value, so Universe(std::move(planets)) does not copy them at all
+    */
+    Universe(std::vector<Planet> planets) : _planets(std::move(planets))
     {
-        _compute_magnitudes();
-        _compute_half_mass_radius();
-        _relist_positions();
-        // total mass is trivial as all particles have the same mass
-        _total_mass = _magnitudes.size() * _planets[0].mass;
+        _build_radius_index();
+
+        // the planets are sorted by radius once, after this all mass queries are binary searches
+        _total_mass = _radius_index.back().cumulative_mass;
+        _half_mass_radius = lagrangian_radius(0.5);
 
         // calculation as defined in the original paper
         _scale_factor = _half_mass_radius / (1 + sqrt(2));
@@ -44,9 +57,33 @@ public:
 
     /*
     Computes the mass using the given positions
+    The mass of all planets which lie strictly inside the radius, found in O(log N)
     */
     double calculate_mass_specifically(const double &radius) const;
 
+    /*
+    The smallest radius of a planet such that the mass inside of it is at least
+    the given fraction of the total mass, e.g. 0.5 gives the half mass radius
+    */
+    double lagrangian_radius(double fraction) const;
+
+    double half_mass_radius() const { return _half_mass_radius; }
+    double total_mass() const { return _total_mass; }
+    double scale_factor() const { return _scale_factor; }
+    std::size_t size() const { return _planets.size(); }
+
+    /*
+    Views of the positions and of their distances to the origin, nothing is copied
+    */
+    auto positions() const
+    {
+        return _planets | std::views::transform([](const Planet &planet) -> const Eigen::Vector3d & { return planet.position; });
+    }
+    auto magnitudes() const
+    {
+        return _planets | std::views::transform([](const Planet &planet) { return planet.position.norm(); });
+    }
+
     /*
     Computes the mass using equation 3 from the hernquist paper
     */
@@ -58,12 +95,23 @@ public:
     */
     std::vector<Eigen::Vector3d> calculate_direct_nbody_forces(double softening, double G) const;
 
+    /*
+    The same in a periodic box, every pair uses the nearest image plus the tabulated ewald correction for all others
+    */
+    std::vector<Eigen::Vector3d> calculate_direct_nbody_forces(double softening, double G, const PeriodicBox &box) const;
+
     /*
     Calculates the force on each of the particles using the equation in the hernquist paper
     The force is calculated between a particle which sits at the center
     with a mass which corresponds to the calculated mass also from the paper
     */
     std::vector<Eigen::Vector3d> hq_calculate_force(const double &G) const;
+
+    /*
+    Bins the planets into n_bins logarithmic shells from the innermost to the outermost planet
+    and compares density, mass, circular velocity etc. with the hernquist model of this universe
+    */
+    RadialProfile calculate_radial_profile(std::size_t n_bins, double G, unsigned int n_threads = 0) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <utility>
+#include "AsyncExporter.hpp"
+#include "ResultExporter.hpp"
+
+Snapshot::Snapshot(Snapshot &&other) noexcept
+    : positions(std::move(other.positions)), forces(std::move(other.forces)), filename(std::move(other.filename)),
+      _owner(std::exchange(other._owner, nullptr))
+{}
+
+Snapshot &Snapshot::operator=(Snapshot &&other) noexcept
+{
+    if (this != &other)
+    {
+        // a buffer which is overwritten is not lost either
+        _give_back();
+        positions = std::move(other.positions);
+        forces = std::move(other.forces);
+        filename = std::move(other.filename);
+        _owner = std::exchange(other._owner, nullptr);
+    }
+    return *this;
+}
+
+Snapshot::~Snapshot()
+{
+    _give_back();
+}
+
+void Snapshot::_give_back()
+{
+    if (_owner != nullptr)
+        _owner->release(std::move(*this));
+}
+
+AsyncExporter::AsyncExporter(std::size_t n_buffers, ExportFormat format, int precision)
+    : _n_buffers(n_buffers > 0 ? n_buffers : 1), _exporter(format, precision)
+{
+    _free.resize(_n_buffers);
+    _writer = std::thread(&AsyncExporter::_run, this);
+}
+
+AsyncExporter::~AsyncExporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _work_available.notify_one();
+    _writer.join();
+}
+
+Snapshot AsyncExporter::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // backpressure: wait until the writer gave back a buffer
+    _buffer_released.wait(lock, [this]() { return _in_use < _n_buffers; });
+    _in_use++;
+
+    Snapshot snapshot = std::move(_free.back());
+    _free.pop_back();
+    snapshot._owner = this;
+    return snapshot;
+}
+
+void AsyncExporter::submit(Snapshot &&snapshot)
+{
+    // from now on the writer thread gives the buffer back
+    snapshot._owner = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.push_back(std::move(snapshot));
+    }
+    _work_available.notify_one();
+}
+
+void AsyncExporter::release(Snapshot &&snapshot)
+{
+    if (snapshot._owner != this)
+        return;
+    snapshot._owner = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(std::move(snapshot));
+        _in_use--;
+    }
+    _buffer_released.notify_all();
+}
+
+void AsyncExporter::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _buffer_released.wait(lock, [this]() { return _pending.empty() && !_writing; });
+}
+
+void AsyncExporter::_run()
+{
+    while (true)
+    {
+        Snapshot snapshot;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _work_available.wait(lock, [this]() { return _stop || !_pending.empty(); });
+
+            // when stopping we still write everything which was submitted
+            if (_pending.empty())
+                return;
+
+            snapshot = std::move(_pending.front());
+            _pending.pop_front();
+            _writing = true;
+        }
+
+        // the actual disk access happens without holding the lock
+        _exporter.write_force_computation(snapshot.positions, snapshot.forces, snapshot.filename);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _free.push_back(std::move(snapshot));
+            _in_use--;
+            _writing = false;
+        }
+        _buffer_released.notify_all();
+    }
+}
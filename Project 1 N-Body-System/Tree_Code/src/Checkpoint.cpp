@@ -0,0 +1,219 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <Eigen/Dense>
+#include "Checkpoint.hpp"
+
+namespace
+{
+    const char checkpoint_magic[8] = {'N', 'B', 'C', 'K', 'P', 'T', '0', '4'};
+
+    // FNV-1a, enough to notice a truncated or overwritten file
+    std::uint64_t checksum(const std::vector<char> &bytes)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char byte : bytes)
+        {
+            hash ^= static_cast<unsigned char>(byte);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    void put(std::vector<char> &bytes, T value)
+    {
+        const char *begin = reinterpret_cast<const char *>(&value);
+        bytes.insert(bytes.end(), begin, begin + sizeof(T));
+    }
+
+    void put(std::vector<char> &bytes, const Eigen::Vector3d &vector)
+    {
+        put(bytes, vector.x());
+        put(bytes, vector.y());
+        put(bytes, vector.z());
+    }
+
+    // reads from a buffer and remembers if it ran past the end
+    struct Cursor
+    {
+        const std::vector<char> &bytes;
+        std::size_t position = 0;
+        bool ok = true;
+
+        template <typename T>
+        T get()
+        {
+            T value{};
+            if (position + sizeof(T) > bytes.size())
+            {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, bytes.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        Eigen::Vector3d get_vector()
+        {
+            double x = get<double>();
+            double y = get<double>();
+            double z = get<double>();
+            return Eigen::Vector3d(x, y, z);
+        }
+    };
+}
+
+Checkpoint Checkpoint::capture(std::uint64_t step, const SimulationParameters &parameters,
+                               const std::vector<Planet> &planets, const NBodyIntegrator &integrator)
+{
+    Checkpoint checkpoint;
+    checkpoint.step = step;
+    checkpoint.time = integrator.time();
+    checkpoint.parameters = parameters;
+    checkpoint.planets = planets;
+    checkpoint.accelerations = integrator.known_accelerations();
+    return checkpoint;
+}
+
+void Checkpoint::restore(NBodyIntegrator &integrator) const
+{
+    integrator.restore(time, accelerations);
+}
+
+bool Checkpoint::save(const std::string &filename) const
+{
+    std::vector<char> bytes;
+    bytes.reserve(128 + planets.size() * 8 * sizeof(double) + accelerations.size() * 3 * sizeof(double));
+
+    bytes.insert(bytes.end(), checkpoint_magic, checkpoint_magic + 8);
+    put<std::uint64_t>(bytes, step);
+    put<double>(bytes, time);
+
+    put<double>(bytes, parameters.dt);
+    put<double>(bytes, parameters.G);
+    put<double>(bytes, parameters.theta);
+    put<std::int32_t>(bytes, parameters.limit);
+    put<std::int32_t>(bytes, static_cast<std::int32_t>(parameters.scheme));
+    put<std::int32_t>(bytes, static_cast<std::int32_t>(parameters.backend));
+    put<double>(bytes, parameters.softening);
+    put<double>(bytes, parameters.box_size);
+    put<std::int32_t>(bytes, parameters.quadrupole ? 1 : 0);
+
+    put<std::uint64_t>(bytes, planets.size());
+    put<std::uint64_t>(bytes, accelerations.size());
+    for (const auto &planet : planets)
+    {
+        put<double>(bytes, planet.mass);
+        put<double>(bytes, planet.potential);
+        put(bytes, planet.position);
+        put(bytes, planet.velocity);
+    }
+    for (const auto &acceleration : accelerations)
+    {
+        put(bytes, acceleration);
+    }
+    put<std::uint64_t>(bytes, checksum(bytes));
+
+    // write everything to a temporary file first, the old checkpoint stays valid until the rename
+    const std::string temporary = filename + ".tmp";
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Failed to open file: " << temporary << "\n";
+        return false;
+    }
+
+    bool success = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    success = (std::fflush(file) == 0) && success;
+    // the data has to be on the disk before the rename, otherwise a crash can leave the renamed file empty
+    success = (fsync(fileno(file)) == 0) && success;
+    success = (std::fclose(file) == 0) && success;
+
+    // rename replaces the old file in one go (on POSIX systems)
+    if (!success || std::rename(temporary.c_str(), filename.c_str()) != 0)
+    {
+        std::cout << "Failed to write checkpoint: " << filename << "\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::load(const std::string &filename)
+{
+    std::FILE *file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    std::vector<char> bytes;
+    char chunk[1 << 16];
+    std::size_t n_read;
+    while ((n_read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + n_read);
+    std::fclose(file);
+
+    if (bytes.size() < 16 || std::memcmp(bytes.data(), checkpoint_magic, 8) != 0)
+    {
+        std::cout << "Not a checkpoint: " << filename << "\n";
+        return false;
+    }
+
+    // the checksum covers everything in front of it
+    std::uint64_t stored_checksum;
+    std::memcpy(&stored_checksum, bytes.data() + bytes.size() - 8, 8);
+    bytes.resize(bytes.size() - 8);
+    if (checksum(bytes) != stored_checksum)
+    {
+        std::cout << "Checkpoint is broken (wrong checksum): " << filename << "\n";
+        return false;
+    }
+
+    Cursor cursor{bytes, 8};
+    Checkpoint checkpoint;
+    checkpoint.step = cursor.get<std::uint64_t>();
+    checkpoint.time = cursor.get<double>();
+
+    checkpoint.parameters.dt = cursor.get<double>();
+    checkpoint.parameters.G = cursor.get<double>();
+    checkpoint.parameters.theta = cursor.get<double>();
+    checkpoint.parameters.limit = cursor.get<std::int32_t>();
+    checkpoint.parameters.scheme = static_cast<IntegrationScheme>(cursor.get<std::int32_t>());
+    checkpoint.parameters.backend = static_cast<ForceBackend>(cursor.get<std::int32_t>());
+    checkpoint.parameters.softening = cursor.get<double>();
+    checkpoint.parameters.box_size = cursor.get<double>();
+    checkpoint.parameters.quadrupole = cursor.get<std::int32_t>() != 0;
+
+    std::uint64_t n_planets = cursor.get<std::uint64_t>();
+    std::uint64_t n_accelerations = cursor.get<std::uint64_t>();
+    if (!cursor.ok || bytes.size() - cursor.position != (8 * n_planets + 3 * n_accelerations) * sizeof(double))
+    {
+        std::cout << "Checkpoint has the wrong size: " << filename << "\n";
+        return false;
+    }
+
+    checkpoint.planets.reserve(n_planets);
+    for (std::uint64_t i = 0; i < n_planets; i++)
+    {
+        double mass = cursor.get<double>();
+        double potential = cursor.get<double>();
+        Eigen::Vector3d position = cursor.get_vector();
+        Eigen::Vector3d velocity = cursor.get_vector();
+        checkpoint.planets.push_back(Planet(mass, potential, position, velocity));
+    }
+
+    checkpoint.accelerations.reserve(n_accelerations);
+    for (std::uint64_t i = 0; i < n_accelerations; i++)
+    {
+        checkpoint.accelerations.push_back(cursor.get_vector());
+    }
+
+    *this = std::move(checkpoint);
+    return true;
+}
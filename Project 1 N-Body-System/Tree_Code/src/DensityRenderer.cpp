@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Parallel.hpp"
+#include "ResultExporter.hpp"
+#include "DensityRenderer.hpp"
+
+namespace
+{
+    // the cubic spline with q = r / radius, it reaches to q = 1
+    double kernel(double q)
+    {
+        if (q >= 1.0)
+            return 0.0;
+        if (q < 0.5)
+            return 1.0 - 6.0 * q * q + 6.0 * q * q * q;
+        double t = 1.0 - q;
+        return 2.0 * t * t * t;
+    }
+}
+
+DensityRenderer::DensityRenderer(const RenderSettings &settings, unsigned int n_threads)
+    : _settings(settings), _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    _settings.width = std::max<std::size_t>(_settings.width, 1);
+    _settings.height = std::max<std::size_t>(_settings.height, 1);
+    _pixel_size = 2 * _settings.half_width / _settings.width;
+}
+
+const std::vector<float> &DensityRenderer::render(std::span<const Planet> planets)
+{
+    return _render(planets, {});
+}
+
+const std::vector<float> &DensityRenderer::render(std::span<const Planet> planets, std::span<const double> smoothing_lengths)
+{
+    return _render(planets, smoothing_lengths);
+}
+
+void DensityRenderer::_splat(double *buffer, double column, double row, double radius, double mass) const
+{
+    const long width = static_cast<long>(_settings.width);
+    const long height = static_cast<long>(_settings.height);
+
+    // the pixels whose centers lie within the kernel, the centers are at integer + 0.5
+    long first_column = static_cast<long>(std::floor(column - radius));
+    long last_column = static_cast<long>(std::floor(column + radius));
+    long first_row = static_cast<long>(std::floor(row - radius));
+    long last_row = static_cast<long>(std::floor(row + radius));
+
+    // over a few pixels the sum of the weights is the integral of the kernel, pi R^2 7 / 40
+    // a small kernel is normalised by the sum over all pixels it touches, also the ones outside of the image,
+    // so in both cases the part of the mass which falls outside is lost and not pushed back into the image
+    // a small kernel may not reach the center of any pixel, then the pixel of the planet gets everything
+    double total = 0.0;
+    double inverse_radius = 1.0 / radius;
+    if (radius >= 2.0)
+    {
+        total = 7.0 * M_PI * radius * radius / 40.0;
+    }
+    else
+    {
+        for (long j = first_row; j <= last_row; j++)
+        {
+            double dy = (j + 0.5 - row) * inverse_radius;
+            for (long i = first_column; i <= last_column; i++)
+            {
+                double dx = (i + 0.5 - column) * inverse_radius;
+                total += kernel(std::sqrt(dx * dx + dy * dy));
+            }
+        }
+    }
+
+    if (total <= 0.0)
+    {
+        long i = static_cast<long>(std::floor(column));
+        long j = static_cast<long>(std::floor(row));
+        if (i >= 0 && i < width && j >= 0 && j < height)
+            buffer[j * width + i] += mass;
+        return;
+    }
+
+    // only the pixels inside of the image are written
+    first_column = std::max(0L, first_column);
+    last_column = std::min(width - 1, last_column);
+    first_row = std::max(0L, first_row);
+    last_row = std::min(height - 1, last_row);
+
+    double factor = mass / total;
+    for (long j = first_row; j <= last_row; j++)
+    {
+        double dy = (j + 0.5 - row) * inverse_radius;
+        for (long i = first_column; i <= last_column; i++)
+        {
+            double dx = (i + 0.5 - column) * inverse_radius;
+            buffer[j * width + i] += factor * kernel(std::sqrt(dx * dx + dy * dy));
+        }
+    }
+}
+
+const std::vector<float> &DensityRenderer::_render(std::span<const Planet> planets, std::span<const double> smoothing_lengths)
+{
+    const std::size_t n_pixels = _settings.width * _settings.height;
+    _buffers.assign(_n_threads * n_pixels, 0.0);
+
+    // the two coordinates of the image
+    int horizontal = 0;
+    int vertical = 1;
+    switch (_settings.axis)
+    {
+    case ProjectionAxis::x:
+        horizontal = 1;
+        vertical = 2;
+        break;
+    case ProjectionAxis::y:
+        horizontal = 2;
+        vertical = 0;
+        break;
+    case ProjectionAxis::z:
+        horizontal = 0;
+        vertical = 1;
+        break;
+    }
+
+    const double inverse_pixel = 1.0 / _pixel_size;
+    const double left = _settings.center(horizontal) - _settings.half_width;
+    const double top = _settings.center(vertical) + 0.5 * _settings.height * _pixel_size;
+    const bool own_smoothing = !smoothing_lengths.empty();
+
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        double *buffer = _buffers.data() + thread * n_pixels;
+        for (std::size_t k = begin; k < end; k++)
+        {
+            double column = (planets[k].position(horizontal) - left) * inverse_pixel;
+            double row = (top - planets[k].position(vertical)) * inverse_pixel;
+            double radius = own_smoothing ? smoothing_lengths[k] * inverse_pixel : _settings.smoothing;
+
+            // planets whose kernel does not reach the image are skipped right away
+            if (column + radius < 0 || row + radius < 0 || column - radius > _settings.width || row - radius > _settings.height)
+                continue;
+            _splat(buffer, column, row, std::max(radius, 1e-3), planets[k].mass);
+        }
+    }, _n_threads);
+
+    // the images of the threads are added up, per pixel so this is parallel as well
+    _image.assign(n_pixels, 0.0f);
+    const double inverse_area = inverse_pixel * inverse_pixel;
+    parallel_for(n_pixels, [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t p = begin; p < end; p++)
+        {
+            double sum = 0.0;
+            for (std::size_t thread = 0; thread < _n_threads; thread++)
+                sum += _buffers[thread * n_pixels + p];
+            _image[p] = static_cast<float>(sum * inverse_area);
+        }
+    }, _n_threads);
+    return _image;
+}
+
+bool DensityRenderer::write_pgm(const std::string &filename) const
+{
+    std::FILE *file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return false;
+    }
+
+    // everything below max / dynamic_range is black
+    float maximum = _image.empty() ? 0.0f : *std::max_element(_image.begin(), _image.end());
+    double log_max = std::log(std::max<double>(maximum, 1e-300));
+    double log_min = log_max - std::log(std::max(_settings.dynamic_range, 1.0 + 1e-12));
+
+    std::vector<unsigned char> pixels(_image.size());
+    for (std::size_t p = 0; p < _image.size(); p++)
+    {
+        double value = _image[p] > 0 ? (std::log(_image[p]) - log_min) / (log_max - log_min) : 0.0;
+        pixels[p] = static_cast<unsigned char>(std::clamp(value, 0.0, 1.0) * 255.0 + 0.5);
+    }
+
+    std::string header = "P5\n" + std::to_string(_settings.width) + " " + std::to_string(_settings.height) + "\n255\n";
+    bool success = std::fwrite(header.data(), 1, header.size(), file) == header.size() &&
+                   std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    std::fclose(file);
+    return success;
+}
+
+bool DensityRenderer::write_npy(const std::string &filename) const
+{
+    std::FILE *file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return false;
+    }
+
+    std::string header = ResultExporter::npy_header(_settings.height, _settings.width, "f4");
+    bool success = std::fwrite(header.data(), 1, header.size(), file) == header.size() &&
+                   std::fwrite(_image.data(), sizeof(float), _image.size(), file) == _image.size();
+    std::fclose(file);
+    return success;
+}
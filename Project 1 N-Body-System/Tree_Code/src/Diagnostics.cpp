@@ -0,0 +1,95 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "Diagnostics.hpp"
+
+Diagnostics::Diagnostics(double G, double theta, int limit, double softening, unsigned int n_threads)
+    : _G(G), _theta(theta), _limit(limit), _softening(softening),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{}
+
+const EnergyDiagnostics &Diagnostics::compute(std::span<const Planet> planets, std::span<const double> potentials, double time)
+{
+    // the sums of every thread, added up in a fixed order afterwards
+    struct Sums
+    {
+        double kinetic = 0;
+        double potential = 0;
+        Eigen::Vector3d angular_momentum = Eigen::Vector3d::Zero();
+        Eigen::Vector3d momentum = Eigen::Vector3d::Zero();
+    };
+    std::vector<Sums> sums(_n_threads);
+
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        Sums local;
+        for (std::size_t i = begin; i < end; i++)
+        {
+            const Planet &p = planets[i];
+            local.kinetic += 0.5 * p.mass * p.velocity.squaredNorm();
+            local.potential += 0.5 * p.mass * potentials[i];
+            local.angular_momentum += p.mass * p.position.cross(p.velocity);
+            local.momentum += p.mass * p.velocity;
+        }
+        sums[thread] = local;
+    }, _n_threads);
+
+    EnergyDiagnostics result{};
+    result.time = time;
+    result.angular_momentum = Eigen::Vector3d::Zero();
+    result.momentum = Eigen::Vector3d::Zero();
+    for (const auto &s : sums)
+    {
+        result.kinetic_energy += s.kinetic;
+        result.potential_energy += s.potential;
+        result.angular_momentum += s.angular_momentum;
+        result.momentum += s.momentum;
+    }
+    result.total_energy = result.kinetic_energy + result.potential_energy;
+    result.virial_ratio = result.potential_energy != 0.0 ? 2 * result.kinetic_energy / std::abs(result.potential_energy) : 0.0;
+
+    double initial_energy = _history.empty() ? result.total_energy : _history.front().total_energy;
+    result.energy_error = initial_energy != 0.0 ? (result.total_energy - initial_energy) / std::abs(initial_energy) : 0.0;
+
+    _history.push_back(result);
+    return _history.back();
+}
+
+const EnergyDiagnostics &Diagnostics::compute(const std::vector<Planet> &planets, double time)
+{
+    Node tree = Node::build(planets, _limit, _G, _theta, _softening);
+
+    _potentials.resize(planets.size());
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+            _potentials[i] = tree.compute_potential(planets[i]);
+    }, _n_threads);
+
+    return compute(planets, _potentials, time);
+}
+
+void Diagnostics::export_to_file(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    file << "time;kinetic_energy;potential_energy;total_energy;virial_ratio;energy_error;L_x;L_y;L_z;p_x;p_y;p_z\n";
+    file.precision(12);
+    for (const auto &d : _history)
+    {
+        file << d.time << ";" << d.kinetic_energy << ";" << d.potential_energy << ";" << d.total_energy << ";"
+             << d.virial_ratio << ";" << d.energy_error << ";"
+             << d.angular_momentum.x() << ";" << d.angular_momentum.y() << ";" << d.angular_momentum.z() << ";"
+             << d.momentum.x() << ";" << d.momentum.y() << ";" << d.momentum.z() << "\n";
+    }
+}
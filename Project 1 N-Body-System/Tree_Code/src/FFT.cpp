@@ -0,0 +1,114 @@
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <math.h>
+#include "Parallel.hpp"
+#include "FFT.hpp"
+
+FFT::FFT(std::size_t n) : _n(n)
+{
+    if (!is_power_of_two(n))
+    {
+        std::cout << "FFT length " << n << " is not a power of 2\n";
+        _n = 1;
+    }
+
+    _twiddles.resize(_n / 2);
+    for (std::size_t k = 0; k < _n / 2; k++)
+    {
+        _twiddles[k] = std::polar(1.0, -2 * M_PI * k / _n);
+    }
+
+    std::size_t bits = 0;
+    while ((std::size_t(1) << bits) < _n)
+        bits++;
+    _bit_reversed.resize(_n);
+    for (std::size_t i = 0; i < _n; i++)
+    {
+        std::size_t reversed = 0;
+        for (std::size_t b = 0; b < bits; b++)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        _bit_reversed[i] = reversed;
+    }
+}
+
+void FFT::transform(std::complex<double> *data, std::size_t stride, bool inverse) const
+{
+    for (std::size_t i = 0; i < _n; i++)
+    {
+        std::size_t j = _bit_reversed[i];
+        if (i < j)
+            std::swap(data[i * stride], data[j * stride]);
+    }
+
+    // butterflies of growing length, the twiddles of length n are reused with a step
+    for (std::size_t length = 2; length <= _n; length *= 2)
+    {
+        std::size_t half = length / 2;
+        std::size_t step = _n / length;
+        for (std::size_t start = 0; start < _n; start += length)
+        {
+            for (std::size_t k = 0; k < half; k++)
+            {
+                std::complex<double> w = _twiddles[k * step];
+                if (inverse)
+                    w = std::conj(w);
+
+                std::complex<double> &a = data[(start + k) * stride];
+                std::complex<double> &b = data[(start + k + half) * stride];
+                std::complex<double> t = w * b;
+                b = a - t;
+                a = a + t;
+            }
+        }
+    }
+}
+
+void FFT::transform_3d(std::vector<std::complex<double>> &data, bool inverse, unsigned int n_threads, std::size_t band) const
+{
+    const std::size_t n = _n;
+    if (band == 0 || band > n)
+        band = n;
+
+    // the lines along z are contiguous, with x < x_end and y < y_end
+    auto transform_z = [&](std::size_t x_end, std::size_t y_end) {
+        parallel_for(x_end * y_end, [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t line = begin; line < end; line++)
+                transform(data.data() + ((line / y_end) * n + line % y_end) * n, 1, inverse);
+        }, n_threads);
+    };
+
+    // the other two axes are copied into a buffer first, which is much faster than jumping through the whole cube
+    // lines along y start at x * n^2 + z, lines along x at y * n + z
+    auto transform_strided = [&](std::size_t stride, std::size_t n_lines) {
+        parallel_for(n_lines, [&](std::size_t begin, std::size_t end, unsigned int) {
+            std::vector<std::complex<double>> buffer(n);
+            for (std::size_t line = begin; line < end; line++)
+            {
+                std::size_t first = (stride == n) ? (line / n) * n * n + line % n : line;
+                for (std::size_t i = 0; i < n; i++)
+                    buffer[i] = data[first + i * stride];
+                transform(buffer.data(), 1, inverse);
+                for (std::size_t i = 0; i < n; i++)
+                    data[first + i * stride] = buffer[i];
+            }
+        }, n_threads);
+    };
+
+    if (!inverse)
+    {
+        // z lines with x or y outside of the band only hold zeros, after that y lines with x outside
+        transform_z(band, band);
+        transform_strided(n, band * n);
+        transform_strided(n * n, n * n);
+    }
+    else
+    {
+        // the same in the opposite order, the last transforms only where the result is needed
+        transform_strided(n * n, n * n);
+        transform_strided(n, band * n);
+        transform_z(band, band);
+    }
+}
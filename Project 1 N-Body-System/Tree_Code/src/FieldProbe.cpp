@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "FieldProbe.hpp"
+
+namespace
+{
+    // spreads the lowest 21 bits of x so there are two zero bits between each of them
+    std::uint64_t spread_bits(std::uint64_t x)
+    {
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffff;
+        x = (x | x << 16) & 0x1f0000ff0000ff;
+        x = (x | x << 8) & 0x100f00f00f00f00f;
+        x = (x | x << 4) & 0x10c30c30c30c30c3;
+        x = (x | x << 2) & 0x1249249249249249;
+        return x;
+    }
+}
+
+FieldProbe::FieldProbe(const Node &tree, std::size_t group_size, unsigned int n_threads)
+    : _tree(tree), _group_size(std::max<std::size_t>(group_size, 1)),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{}
+
+std::vector<std::size_t> FieldProbe::morton_order(const std::vector<Eigen::Vector3d> &points)
+{
+    Eigen::Vector3d lower = points[0];
+    Eigen::Vector3d upper = points[0];
+    for (const auto &point : points)
+    {
+        lower = lower.cwiseMin(point);
+        upper = upper.cwiseMax(point);
+    }
+    double extent = std::max((upper - lower).maxCoeff(), 1e-300);
+    double scale = static_cast<double>((1 << 21) - 1) / extent;
+
+    std::vector<std::pair<std::uint64_t, std::size_t>> keys(points.size());
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        Eigen::Vector3d cell = (points[i] - lower) * scale;
+        keys[i] = {spread_bits(static_cast<std::uint64_t>(cell.x())) << 2 |
+                       spread_bits(static_cast<std::uint64_t>(cell.y())) << 1 |
+                       spread_bits(static_cast<std::uint64_t>(cell.z())),
+                   i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<std::size_t> order(points.size());
+    for (std::size_t i = 0; i < points.size(); i++)
+        order[i] = keys[i].second;
+    return order;
+}
+
+void FieldProbe::evaluate(const std::vector<Eigen::Vector3d> &points)
+{
+    _points = points;
+    _accelerations.assign(points.size(), Eigen::Vector3d::Zero());
+    _potentials.assign(points.size(), 0.0);
+    if (points.empty())
+        return;
+
+    std::vector<std::size_t> order = morton_order(points);
+    std::size_t n_groups = (points.size() + _group_size - 1) / _group_size;
+
+    parallel_for(n_groups, [&](std::size_t begin, std::size_t end, unsigned int) {
+        std::vector<Eigen::Vector3d> group;
+        std::vector<Eigen::Vector3d> accelerations;
+        std::vector<double> potentials;
+        for (std::size_t g = begin; g < end; g++)
+        {
+            std::size_t first = g * _group_size;
+            std::size_t last = std::min(first + _group_size, points.size());
+
+            group.clear();
+            for (std::size_t k = first; k < last; k++)
+                group.push_back(points[order[k]]);
+            Eigen::Vector3d lower = group[0];
+            Eigen::Vector3d upper = group[0];
+            for (const auto &point : group)
+            {
+                lower = lower.cwiseMin(point);
+                upper = upper.cwiseMax(point);
+            }
+
+            accelerations.assign(group.size(), Eigen::Vector3d::Zero());
+            potentials.assign(group.size(), 0.0);
+            _tree.compute_field(group, lower, upper, accelerations, potentials);
+
+            // every point belongs to exactly one group, so the threads write to different places
+            for (std::size_t k = first; k < last; k++)
+            {
+                _accelerations[order[k]] = accelerations[k - first];
+                _potentials[order[k]] = potentials[k - first];
+            }
+        }
+    }, _n_threads);
+}
+
+std::vector<Eigen::Vector3d> FieldProbe::plane(const Eigen::Vector3d &center, const Eigen::Vector3d &axis_u, const Eigen::Vector3d &axis_v,
+                                               double half_width, std::size_t n)
+{
+    std::vector<Eigen::Vector3d> points;
+    points.reserve(n * n);
+    Eigen::Vector3d u = axis_u.normalized();
+    Eigen::Vector3d v = axis_v.normalized();
+    double step = n > 1 ? 2 * half_width / (n - 1) : 0.0;
+    for (std::size_t j = 0; j < n; j++)
+        for (std::size_t i = 0; i < n; i++)
+            points.push_back(center + (-half_width + i * step) * u + (-half_width + j * step) * v);
+    return points;
+}
+
+void FieldProbe::export_to_file(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    file << "x;y;z;ax;ay;az;potential\n";
+    file.precision(10);
+    for (std::size_t i = 0; i < _points.size(); i++)
+    {
+        file << _points[i](0) << ";" << _points[i](1) << ";" << _points[i](2) << ";"
+             << _accelerations[i](0) << ";" << _accelerations[i](1) << ";" << _accelerations[i](2) << ";"
+             << _potentials[i] << "\n";
+    }
+}
@@ -0,0 +1,168 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "ForceSolver.hpp"
+
+std::string backend_name(ForceBackend backend)
+{
+    switch (backend)
+    {
+    case ForceBackend::direct:
+        return "direct";
+    case ForceBackend::tree:
+        return "tree";
+    case ForceBackend::tree_pm:
+        return "TreePM";
+    case ForceBackend::scf:
+        return "SCF";
+    }
+    return "unknown";
+}
+
+ForceSolver::ForceSolver(const ForceSettings &settings, unsigned int n_threads)
+    : _settings(settings), _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    if (_settings.box_size > 0)
+    {
+        // the mesh is isolated and the expansion is around the center, neither knows about images
+        if (_settings.backend == ForceBackend::tree_pm || _settings.backend == ForceBackend::scf)
+        {
+            std::cout << backend_name(_settings.backend) << " does not support a periodic box, using the tree instead\n";
+            _settings.backend = ForceBackend::tree;
+        }
+        _box = std::make_unique<PeriodicBox>(_settings.box_size, _settings.ewald_cache, _settings.ewald_grid, _n_threads);
+    }
+
+    if (_settings.backend == ForceBackend::tree_pm)
+        _mesh = std::make_unique<ParticleMesh>(_settings.mesh_size, _settings.G, _settings.split, _settings.assignment, _n_threads);
+    if (_settings.backend == ForceBackend::scf)
+        _scf = std::make_unique<SCFSolver>(_settings.scf_n_max, _settings.scf_l_max, _settings.scf_scale_length, _settings.G, _n_threads);
+}
+
+std::vector<Eigen::Vector3d> ForceSolver::operator()(const std::vector<Planet> &planets)
+{
+    std::vector<Eigen::Vector3d> accelerations(planets.size(), Eigen::Vector3d::Zero());
+    _potentials.assign(planets.size(), 0.0);
+
+    switch (_settings.backend)
+    {
+    case ForceBackend::direct:
+        if (_box)
+            _periodic_direct(planets, accelerations);
+        else
+            _direct(planets, accelerations);
+        break;
+    case ForceBackend::tree:
+        if (_box)
+            _periodic_tree(planets, accelerations);
+        else
+            _tree(planets, accelerations);
+        break;
+    case ForceBackend::tree_pm:
+        _tree_pm(planets, accelerations);
+        break;
+    case ForceBackend::scf:
+        accelerations = _scf->compute_accelerations(planets);
+        _potentials = _scf->potentials();
+        break;
+    }
+    return accelerations;
+}
+
+void ForceSolver::_direct(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations)
+{
+    // every thread computes whole rows, so actio = reactio is not used but nothing has to be locked
+    const double G = _settings.G;
+    const double s2 = _settings.softening * _settings.softening;
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+            double potential = 0.0;
+            for (std::size_t j = 0; j < planets.size(); j++)
+            {
+                if (j == i)
+                    continue;
+                Eigen::Vector3d r = planets[i].position - planets[j].position;
+                double inverse_r = 1.0 / std::sqrt(r.squaredNorm() + s2);
+                acceleration += -G * planets[j].mass * r * (inverse_r * inverse_r * inverse_r);
+                potential += -G * planets[j].mass * inverse_r;
+            }
+            accelerations[i] = acceleration;
+            _potentials[i] = potential;
+        }
+    }, _n_threads);
+}
+
+void ForceSolver::_tree(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations)
+{
+    Node tree = Node::build(planets, _settings.limit, _settings.G, _settings.theta, _settings.softening, _settings.quadrupole);
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+            tree.compute_acceleration_and_potential(planets[i], accelerations[i], _potentials[i]);
+    }, _n_threads);
+}
+
+void ForceSolver::_periodic_direct(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations)
+{
+    const double G = _settings.G;
+    const double s2 = _settings.softening * _settings.softening;
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+            double potential = 0.0;
+            for (std::size_t j = 0; j < planets.size(); j++)
+            {
+                if (j == i)
+                    continue;
+                Eigen::Vector3d r = _box->minimum_image(planets[i].position - planets[j].position);
+                double inverse_r = 1.0 / std::sqrt(r.squaredNorm() + s2);
+
+                // the nearest image directly, all others with the ewald correction
+                Eigen::Vector3d force;
+                double correction;
+                _box->correction(r, force, correction);
+                acceleration += G * planets[j].mass * (force - r * (inverse_r * inverse_r * inverse_r));
+                potential += G * planets[j].mass * (correction - inverse_r);
+            }
+            accelerations[i] = acceleration;
+            _potentials[i] = potential;
+        }
+    }, _n_threads);
+}
+
+void ForceSolver::_periodic_tree(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations)
+{
+    // the tree needs the planets inside of the box, the integrator does not wrap them
+    std::vector<Planet> wrapped = planets;
+    for (auto &planet : wrapped)
+        planet.position = _box->wrap(planet.position);
+
+    Node tree = Node::build(wrapped, _settings.limit, _settings.G, _settings.theta, _settings.softening, _settings.quadrupole);
+    parallel_for(wrapped.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+            tree.compute_periodic_acceleration_and_potential(wrapped[i], *_box, accelerations[i], _potentials[i]);
+    }, _n_threads);
+}
+
+void ForceSolver::_tree_pm(const std::vector<Planet> &planets, std::vector<Eigen::Vector3d> &accelerations)
+{
+    // the mesh decides the split radius, so it goes first
+    _mesh->add_long_range(planets, accelerations, _potentials);
+
+    const double split_radius = _mesh->split_radius();
+    const double cutoff = _settings.cutoff * split_radius;
+
+    Node tree = Node::build(planets, _settings.limit, _settings.G, _settings.theta, _settings.softening);
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+            tree.compute_short_range_acceleration_and_potential(planets[i], split_radius, cutoff, accelerations[i], _potentials[i]);
+    }, _n_threads);
+}
@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "FriendsOfFriends.hpp"
+
+namespace
+{
+    double min_distance2(const Eigen::Vector3d &lower_a, const Eigen::Vector3d &upper_a,
+                         const Eigen::Vector3d &lower_b, const Eigen::Vector3d &upper_b)
+    {
+        return ((lower_b - upper_a).cwiseMax(0.0) + (lower_a - upper_b).cwiseMax(0.0)).squaredNorm();
+    }
+
+    // the largest distance between a point in box a and a point in box b
+    double max_distance2(const Eigen::Vector3d &lower_a, const Eigen::Vector3d &upper_a,
+                         const Eigen::Vector3d &lower_b, const Eigen::Vector3d &upper_b)
+    {
+        return (upper_b - lower_a).cwiseAbs().cwiseMax((upper_a - lower_b).cwiseAbs()).squaredNorm();
+    }
+
+    void collect_leaves(const Node &node, std::vector<const Node *> &leaves)
+    {
+        if (node.leaf())
+        {
+            if (!node.leaf_planets().empty())
+                leaves.push_back(&node);
+            return;
+        }
+        for (const auto &child : node.child_nodes())
+            collect_leaves(child, leaves);
+    }
+}
+
+FriendsOfFriends::FriendsOfFriends(double linking_length, std::size_t min_members, unsigned int n_threads)
+    : _linking_length(linking_length), _min_members(std::max<std::size_t>(min_members, 1)),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{}
+
+double FriendsOfFriends::linking_length(std::size_t n_planets, double volume, double b)
+{
+    return b * std::cbrt(volume / static_cast<double>(n_planets));
+}
+
+const std::vector<FoFGroup> &FriendsOfFriends::find(const std::vector<Planet> &planets, int limit)
+{
+    // G and theta do not matter, only the structure of the tree is used
+    Node tree = Node::build(planets, limit, 1.0, 0.5);
+    return find(planets, tree);
+}
+
+const std::vector<FoFGroup> &FriendsOfFriends::find(const std::vector<Planet> &planets, const Node &tree)
+{
+    const std::size_t n = planets.size();
+    _groups.clear();
+    _membership.clear();
+    if (n == 0)
+        return _groups;
+
+    _parent = std::make_unique<std::atomic<std::size_t>[]>(n);
+    for (std::size_t i = 0; i < n; i++)
+        _parent[i].store(i, std::memory_order_relaxed);
+
+    // all planets of a node which is smaller than the linking length are friends of each other
+    // linking them first allows the walks below to link such nodes with a single union
+    const double b2 = _linking_length * _linking_length;
+    std::vector<const Node *> compact;
+    std::vector<const Node *> open = {&tree};
+    while (!open.empty())
+    {
+        const Node *node = open.back();
+        open.pop_back();
+        if ((node->upper_corner() - node->lower_corner()).squaredNorm() <= b2)
+            compact.push_back(node);
+        else
+            for (const auto &child : node->child_nodes())
+                open.push_back(&child);
+    }
+    parallel_for(compact.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t c = begin; c < end; c++)
+            _link_all(*compact[c], _representative(*compact[c]));
+    }, _n_threads);
+
+    std::vector<const Node *> leaves;
+    collect_leaves(tree, leaves);
+    parallel_for(leaves.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t l = begin; l < end; l++)
+        {
+            const Node &leaf = *leaves[l];
+            const auto &planets_in_leaf = leaf.leaf_planets();
+            const auto &indices = leaf.leaf_indices();
+
+            // the smallest box around the planets of the leaf, its own pairs first
+            Eigen::Vector3d lower = planets_in_leaf[0].position;
+            Eigen::Vector3d upper = planets_in_leaf[0].position;
+            for (std::size_t m = 0; m < planets_in_leaf.size(); m++)
+            {
+                lower = lower.cwiseMin(planets_in_leaf[m].position);
+                upper = upper.cwiseMax(planets_in_leaf[m].position);
+                for (std::size_t k = m + 1; k < planets_in_leaf.size(); k++)
+                    if ((planets_in_leaf[m].position - planets_in_leaf[k].position).squaredNorm() <= b2)
+                        _unite(indices[m], indices[k]);
+            }
+            _link_leaf(leaf, tree, lower, upper);
+        }
+    }, _n_threads);
+
+    _collect_groups(planets);
+    return _groups;
+}
+
+const std::vector<FoFGroup> &FriendsOfFriends::find_direct(const std::vector<Planet> &planets)
+{
+    const std::size_t n = planets.size();
+    _groups.clear();
+    _membership.clear();
+    if (n == 0)
+        return _groups;
+
+    _parent = std::make_unique<std::atomic<std::size_t>[]>(n);
+    for (std::size_t i = 0; i < n; i++)
+        _parent[i].store(i, std::memory_order_relaxed);
+
+    const double b2 = _linking_length * _linking_length;
+    parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+            for (std::size_t j = i + 1; j < n; j++)
+                if ((planets[i].position - planets[j].position).squaredNorm() <= b2)
+                    _unite(i, j);
+    }, _n_threads);
+
+    _collect_groups(planets);
+    return _groups;
+}
+
+bool FriendsOfFriends::same_partition(const std::vector<long> &a, const std::vector<long> &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    // the group numbers may differ, but a group of a has to be exactly one group of b and the other way round
+    std::vector<long> a_to_b(a.size(), -2);
+    std::vector<long> b_to_a(b.size(), -2);
+    for (std::size_t i = 0; i < a.size(); i++)
+    {
+        if ((a[i] < 0) != (b[i] < 0))
+            return false;
+        if (a[i] < 0)
+            continue;
+        if (a_to_b[a[i]] == -2)
+            a_to_b[a[i]] = b[i];
+        if (b_to_a[b[i]] == -2)
+            b_to_a[b[i]] = a[i];
+        if (a_to_b[a[i]] != b[i] || b_to_a[b[i]] != a[i])
+            return false;
+    }
+    return true;
+}
+
+std::size_t FriendsOfFriends::_find_root(std::size_t i) const
+{
+    // path halving: every planet on the way is moved up to its grandparent, this is safe with compare and swap
+    std::size_t parent = _parent[i].load(std::memory_order_relaxed);
+    while (parent != i)
+    {
+        std::size_t grandparent = _parent[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent)
+            _parent[i].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        i = grandparent;
+        parent = _parent[i].load(std::memory_order_relaxed);
+    }
+    return i;
+}
+
+void FriendsOfFriends::_unite(std::size_t a, std::size_t b) const
+{
+    while (true)
+    {
+        a = _find_root(a);
+        b = _find_root(b);
+        if (a == b)
+            return;
+
+        // the larger root is always linked below the smaller one, so no cycles can appear
+        // if another thread linked a in the meantime, the roots are searched again
+        if (a < b)
+            std::swap(a, b);
+        std::size_t expected = a;
+        if (_parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+            return;
+    }
+}
+
+std::size_t FriendsOfFriends::_representative(const Node &node)
+{
+    const Node *current = &node;
+    while (!current->leaf())
+        current = &current->child_nodes().front();
+    return current->leaf_indices().front();
+}
+
+void FriendsOfFriends::_link_all(const Node &node, std::size_t root) const
+{
+    if (node.leaf())
+    {
+        for (std::size_t index : node.leaf_indices())
+            _unite(root, index);
+        return;
+    }
+    for (const auto &child : node.child_nodes())
+        _link_all(child, root);
+}
+
+void FriendsOfFriends::_link_leaf(const Node &leaf, const Node &node, const Eigen::Vector3d &lower, const Eigen::Vector3d &upper) const
+{
+    if (&node == &leaf)
+        return;
+
+    const double b2 = _linking_length * _linking_length;
+    const Eigen::Vector3d node_lower = node.lower_corner();
+    const Eigen::Vector3d node_upper = node.upper_corner();
+    if (min_distance2(lower, upper, node_lower, node_upper) > b2)
+        return;
+
+    // every planet of the node is a friend of every planet of the leaf
+    // only nodes smaller than the linking length are taken as a whole, as only their planets are already
+    // linked with each other (see find). The planets of the leaf can be further apart, so all of them are linked
+    if (max_distance2(lower, upper, node_lower, node_upper) <= b2 && (node_upper - node_lower).squaredNorm() <= b2)
+    {
+        const std::size_t root = _representative(node);
+        for (std::size_t index : leaf.leaf_indices())
+            _unite(index, root);
+        return;
+    }
+
+    if (!node.leaf())
+    {
+        for (const auto &child : node.child_nodes())
+            _link_leaf(leaf, child, lower, upper);
+        return;
+    }
+
+    // the pairs of two leaves are only looked at by one of them
+    if (&node < &leaf)
+        return;
+
+    const auto &planets = leaf.leaf_planets();
+    const auto &indices = leaf.leaf_indices();
+    const auto &others = node.leaf_planets();
+    const auto &other_indices = node.leaf_indices();
+    for (std::size_t m = 0; m < planets.size(); m++)
+        for (std::size_t k = 0; k < others.size(); k++)
+            if ((planets[m].position - others[k].position).squaredNorm() <= b2)
+                _unite(indices[m], other_indices[k]);
+}
+
+void FriendsOfFriends::_collect_groups(const std::vector<Planet> &planets)
+{
+    const std::size_t n = planets.size();
+
+    std::vector<std::size_t> root(n);
+    std::vector<std::size_t> count(n, 0);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        root[i] = _find_root(i);
+        count[root[i]]++;
+    }
+
+    // the roots of large enough groups get a group index
+    std::vector<long> group_of_root(n, -1);
+    _groups.clear();
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (root[i] == i && count[i] >= _min_members)
+        {
+            group_of_root[i] = static_cast<long>(_groups.size());
+            _groups.push_back({count[i], 0.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0.0});
+        }
+    }
+
+    _membership.assign(n, -1);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        long g = group_of_root[root[i]];
+        _membership[i] = g;
+        if (g < 0)
+            continue;
+        _groups[g].mass += planets[i].mass;
+        _groups[g].center += planets[i].mass * planets[i].position;
+        _groups[g].velocity += planets[i].mass * planets[i].velocity;
+    }
+    for (auto &group : _groups)
+    {
+        group.center /= group.mass;
+        group.velocity /= group.mass;
+    }
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (_membership[i] >= 0)
+        {
+            FoFGroup &group = _groups[_membership[i]];
+            group.radius = std::max(group.radius, (planets[i].position - group.center).norm());
+        }
+    }
+
+    // the most massive group first
+    std::vector<std::size_t> order(_groups.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) { return _groups[a].mass > _groups[b].mass; });
+    std::vector<long> new_index(_groups.size());
+    std::vector<FoFGroup> sorted;
+    sorted.reserve(_groups.size());
+    for (std::size_t k = 0; k < order.size(); k++)
+    {
+        new_index[order[k]] = static_cast<long>(k);
+        sorted.push_back(_groups[order[k]]);
+    }
+    _groups = std::move(sorted);
+    for (auto &g : _membership)
+        if (g >= 0)
+            g = new_index[g];
+
+    // the union find is only needed while searching
+    _parent.reset();
+}
+
+void FriendsOfFriends::export_to_file(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    file << "n_members;mass;x;y;z;vx;vy;vz;radius\n";
+    file.precision(10);
+    for (const auto &group : _groups)
+    {
+        file << group.n_members << ";" << group.mass << ";"
+             << group.center(0) << ";" << group.center(1) << ";" << group.center(2) << ";"
+             << group.velocity(0) << ";" << group.velocity(1) << ";" << group.velocity(2) << ";"
+             << group.radius << "\n";
+    }
+}
@@ -0,0 +1,116 @@
+#include <vector>
+#include <cmath>
+#include <utility>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "NBodyIntegrator.hpp"
+
+NBodyIntegrator::NBodyIntegrator(AccelerationFunction acceleration_function, IntegrationScheme scheme)
+    : _acceleration_function(acceleration_function), _scheme(scheme)
+{
+    scheme_weights(scheme, _kicks, _drifts);
+}
+
+void NBodyIntegrator::scheme_weights(IntegrationScheme scheme, std::vector<double> &kicks, std::vector<double> &drifts)
+{
+    // the triple jump of Yoshida (1990) and Forest & Ruth (1990)
+    const double theta = 1.0 / (2.0 - std::cbrt(2.0));
+
+    switch (scheme)
+    {
+    case IntegrationScheme::leap_frog:
+        _set_leap_frog_weights({1.0}, kicks, drifts);
+        break;
+    case IntegrationScheme::yoshida_4:
+        _set_leap_frog_weights({theta, 1.0 - 2.0 * theta, theta}, kicks, drifts);
+        break;
+    case IntegrationScheme::yoshida_6:
+    {
+        // solution A of Yoshida (1990), table 1
+        const double w1 = -1.17767998417887;
+        const double w2 = 0.235573213359357;
+        const double w3 = 0.784513610477560;
+        const double w0 = 1.0 - 2.0 * (w1 + w2 + w3);
+        _set_leap_frog_weights({w3, w2, w1, w0, w1, w2, w3}, kicks, drifts);
+        break;
+    }
+    case IntegrationScheme::forest_ruth:
+        // the position version, which starts and ends with a drift
+        kicks = {0.0, theta, 1.0 - 2.0 * theta, theta, 0.0};
+        drifts = {theta / 2, (1.0 - theta) / 2, (1.0 - theta) / 2, theta / 2};
+        break;
+    }
+}
+
+void NBodyIntegrator::_set_leap_frog_weights(const std::vector<double> &weights, std::vector<double> &kicks, std::vector<double> &drifts)
+{
+    // the last half kick of a leap frog step and the first one of the next step
+    // happen at the same position, so they can be merged into one kick
+    kicks.assign(weights.size() + 1, 0.0);
+    drifts = weights;
+    for (std::size_t i = 0; i < weights.size(); i++)
+    {
+        kicks[i] += weights[i] / 2;
+        kicks[i + 1] += weights[i] / 2;
+    }
+}
+
+const std::vector<Eigen::Vector3d> &NBodyIntegrator::accelerations(const std::vector<Planet> &planets)
+{
+    if (!_accelerations_valid)
+    {
+        _accelerations = _acceleration_function(planets);
+        _accelerations_valid = true;
+    }
+    return _accelerations;
+}
+
+void NBodyIntegrator::restore(double time, std::vector<Eigen::Vector3d> accelerations)
+{
+    _time = time;
+    _accelerations = std::move(accelerations);
+    _accelerations_valid = !_accelerations.empty();
+}
+
+void NBodyIntegrator::_kick(std::vector<Planet> &planets, double dt)
+{
+    accelerations(planets);
+
+    for (std::size_t i = 0; i < planets.size(); i++)
+    {
+        planets[i].velocity += _accelerations[i] * dt;
+    }
+}
+
+void NBodyIntegrator::_drift(std::vector<Planet> &planets, double dt)
+{
+    for (auto &planet : planets)
+    {
+        planet.position += planet.velocity * dt;
+    }
+
+    // the positions changed, so the accelerations have to be computed again
+    _accelerations_valid = false;
+}
+
+void NBodyIntegrator::step(std::vector<Planet> &planets, double dt)
+{
+    for (std::size_t i = 0; i < _drifts.size(); i++)
+    {
+        if (_kicks[i] != 0.0)
+            _kick(planets, _kicks[i] * dt);
+        _drift(planets, _drifts[i] * dt);
+    }
+    if (_kicks.back() != 0.0)
+        _kick(planets, _kicks.back() * dt);
+
+    _time += dt;
+}
+
+void NBodyIntegrator::integrate(std::vector<Planet> &planets, double dt, int n_steps)
+{
+    for (int i = 0; i < n_steps; i++)
+    {
+        step(planets, dt);
+    }
+}
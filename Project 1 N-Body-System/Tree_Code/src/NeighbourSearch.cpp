@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <math.h>
+#include <Eigen/Dense>
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "NeighbourSearch.hpp"
+
+namespace
+{
+    // the heaps have the furthest neighbour on top
+    bool closer(const Neighbour &a, const Neighbour &b)
+    {
+        return a.distance2 < b.distance2;
+    }
+
+    // squared distance between two boxes, 0 if they overlap
+    double box_distance2(const Eigen::Vector3d &lower_a, const Eigen::Vector3d &upper_a,
+                         const Eigen::Vector3d &lower_b, const Eigen::Vector3d &upper_b)
+    {
+        return ((lower_b - upper_a).cwiseMax(0.0) + (lower_a - upper_b).cwiseMax(0.0)).squaredNorm();
+    }
+
+    // replaces the furthest neighbour and lets the new one sink down, half the work of pop_heap and push_heap
+    void replace_top(std::vector<Neighbour> &heap, Neighbour neighbour)
+    {
+        std::size_t n = heap.size();
+        std::size_t i = 0;
+        while (true)
+        {
+            std::size_t child = 2 * i + 1;
+            if (child >= n)
+                break;
+            if (child + 1 < n && heap[child + 1].distance2 > heap[child].distance2)
+                child++;
+            if (heap[child].distance2 <= neighbour.distance2)
+                break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = neighbour;
+    }
+
+    // the largest distance any of the heaps still needs, infinite as long as one is not full
+    double heap_bound2(const std::vector<std::vector<Neighbour>> &heaps, std::size_t n, std::size_t k)
+    {
+        double bound2 = 0.0;
+        for (std::size_t m = 0; m < n; m++)
+        {
+            if (heaps[m].size() < k)
+                return std::numeric_limits<double>::infinity();
+            bound2 = std::max(bound2, heaps[m].front().distance2);
+        }
+        return bound2;
+    }
+}
+
+NeighbourSearch::NeighbourSearch(const Node &tree, unsigned int n_threads)
+    : _tree(tree), _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    _collect_leaves(_tree);
+}
+
+void NeighbourSearch::_collect_leaves(const Node &node)
+{
+    if (node.leaf())
+    {
+        if (node.leaf_planets().empty())
+            return;
+        _leaves.push_back(&node);
+        for (std::size_t index : node.leaf_indices())
+            _size = std::max(_size, index + 1);
+        return;
+    }
+    for (const auto &child : node.child_nodes())
+        _collect_leaves(child);
+}
+
+void NeighbourSearch::_positions(const Node &leaf, std::vector<Eigen::Vector3d> &points)
+{
+    points.clear();
+    for (const auto &planet : leaf.leaf_planets())
+        points.push_back(planet.position);
+}
+
+std::vector<Neighbour> NeighbourSearch::nearest(const Eigen::Vector3d &x, std::size_t k) const
+{
+    std::vector<std::vector<Neighbour>> heaps;
+    _nearest({x}, nullptr, k, heaps);
+    return heaps[0];
+}
+
+std::vector<Neighbour> NeighbourSearch::within(const Eigen::Vector3d &x, double radius) const
+{
+    std::vector<std::vector<Neighbour>> lists;
+    _within({x}, {radius}, lists);
+    return lists[0];
+}
+
+void NeighbourSearch::_nearest(const std::vector<Eigen::Vector3d> &points, const Node *own_leaf, std::size_t k,
+                               std::vector<std::vector<Neighbour>> &heaps) const
+{
+    // the buffers are reused from group to group
+    if (heaps.size() < points.size())
+        heaps.resize(points.size());
+    for (std::size_t m = 0; m < points.size(); m++)
+    {
+        heaps[m].clear();
+        heaps[m].reserve(k);
+    }
+    if (k == 0 || points.empty())
+        return;
+
+    // the smallest box around the group, a node further away from it than bound is of no use for any of them
+    Eigen::Vector3d lower = points[0];
+    Eigen::Vector3d upper = points[0];
+    for (const auto &point : points)
+    {
+        lower = lower.cwiseMin(point);
+        upper = upper.cwiseMax(point);
+    }
+
+    // the own leaf first, so the heaps are filled with close planets right away and the walk can prune early
+    double bound2 = std::numeric_limits<double>::infinity();
+    if (own_leaf != nullptr)
+        _walk_nearest(*own_leaf, nullptr, points, lower, upper, k, heaps, bound2);
+    _walk_nearest(_tree, own_leaf, points, lower, upper, k, heaps, bound2);
+
+    for (std::size_t m = 0; m < points.size(); m++)
+        std::sort_heap(heaps[m].begin(), heaps[m].end(), closer);
+}
+
+void NeighbourSearch::_walk_nearest(const Node &node, const Node *skip, const std::vector<Eigen::Vector3d> &points,
+                                    const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, std::size_t k,
+                                    std::vector<std::vector<Neighbour>> &heaps, double &bound2) const
+{
+    if (&node == skip)
+        return;
+
+    const Eigen::Vector3d node_lower = node.lower_corner();
+    const Eigen::Vector3d node_upper = node.upper_corner();
+    if (box_distance2(lower, upper, node_lower, node_upper) > bound2)
+        return;
+
+    if (node.leaf())
+    {
+        const auto &planets = node.leaf_planets();
+        const auto &indices = node.leaf_indices();
+        for (std::size_t m = 0; m < points.size(); m++)
+        {
+            auto &heap = heaps[m];
+            const Eigen::Vector3d &x = points[m];
+
+            // the whole leaf can still be too far for this point, even if it is close enough for the group
+            if (heap.size() == k && box_distance2(x, x, node_lower, node_upper) > heap.front().distance2)
+                continue;
+
+            for (std::size_t j = 0; j < planets.size(); j++)
+            {
+                double distance2 = (planets[j].position - x).squaredNorm();
+                if (heap.size() < k)
+                {
+                    heap.push_back({indices[j], distance2});
+                    std::push_heap(heap.begin(), heap.end(), closer);
+                }
+                else if (distance2 < heap.front().distance2)
+                {
+                    replace_top(heap, {indices[j], distance2});
+                }
+            }
+        }
+        bound2 = heap_bound2(heaps, points.size(), k);
+        return;
+    }
+
+    // the closest children first, they shrink the bound the most
+    const auto &children = node.child_nodes();
+    const Eigen::Vector3d center = (lower + upper) / 2;
+    std::pair<double, const Node *> order[8];
+    std::size_t n_children = 0;
+    for (const auto &child : children)
+        order[n_children++] = {box_distance2(center, center, child.lower_corner(), child.upper_corner()), &child};
+    std::sort(order, order + n_children, [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    for (std::size_t c = 0; c < n_children; c++)
+        _walk_nearest(*order[c].second, skip, points, lower, upper, k, heaps, bound2);
+}
+
+void NeighbourSearch::_within(const std::vector<Eigen::Vector3d> &points, const std::vector<double> &radii,
+                              std::vector<std::vector<Neighbour>> &lists) const
+{
+    if (lists.size() < points.size())
+        lists.resize(points.size());
+    for (std::size_t m = 0; m < points.size(); m++)
+        lists[m].clear();
+    if (points.empty())
+        return;
+
+    // the group walk uses the largest radius, every point then only takes what is within its own
+    Eigen::Vector3d lower = points[0];
+    Eigen::Vector3d upper = points[0];
+    std::vector<double> radii2(points.size());
+    double radius2 = 0.0;
+    for (std::size_t m = 0; m < points.size(); m++)
+    {
+        lower = lower.cwiseMin(points[m]);
+        upper = upper.cwiseMax(points[m]);
+        radii2[m] = radii[m] * radii[m];
+        radius2 = std::max(radius2, radii2[m]);
+    }
+    _walk_within(_tree, points, radii2, lower, upper, radius2, lists);
+}
+
+void NeighbourSearch::_walk_within(const Node &node, const std::vector<Eigen::Vector3d> &points, const std::vector<double> &radii2,
+                                   const Eigen::Vector3d &lower, const Eigen::Vector3d &upper, double radius2,
+                                   std::vector<std::vector<Neighbour>> &lists) const
+{
+    const Eigen::Vector3d node_lower = node.lower_corner();
+    const Eigen::Vector3d node_upper = node.upper_corner();
+    if (box_distance2(lower, upper, node_lower, node_upper) > radius2)
+        return;
+
+    if (!node.leaf())
+    {
+        for (const auto &child : node.child_nodes())
+            _walk_within(child, points, radii2, lower, upper, radius2, lists);
+        return;
+    }
+
+    const auto &planets = node.leaf_planets();
+    const auto &indices = node.leaf_indices();
+    for (std::size_t m = 0; m < points.size(); m++)
+    {
+        const Eigen::Vector3d &x = points[m];
+        if (box_distance2(x, x, node_lower, node_upper) > radii2[m])
+            continue;
+
+        for (std::size_t j = 0; j < planets.size(); j++)
+        {
+            double distance2 = (planets[j].position - x).squaredNorm();
+            if (distance2 <= radii2[m])
+                lists[m].push_back({indices[j], distance2});
+        }
+    }
+}
+
+std::vector<double> NeighbourSearch::kth_neighbour_distances(std::size_t k) const
+{
+    std::vector<double> distances(_size, 0.0);
+    for_each_nearest(k, [&distances](std::size_t index, std::span<const Neighbour> neighbours, unsigned int) {
+        distances[index] = neighbours.empty() ? 0.0 : std::sqrt(neighbours.back().distance2);
+    });
+    return distances;
+}
+
+std::vector<double> NeighbourSearch::densities(std::size_t k) const
+{
+    // the planets are only known to the leaves, so their masses are collected first
+    std::vector<double> masses(_size, 0.0);
+    for (const Node *leaf : _leaves)
+    {
+        const auto &planets = leaf->leaf_planets();
+        const auto &indices = leaf->leaf_indices();
+        for (std::size_t j = 0; j < planets.size(); j++)
+            masses[indices[j]] = planets[j].mass;
+    }
+
+    std::vector<double> densities(_size, 0.0);
+    for_each_nearest(k, [&](std::size_t index, std::span<const Neighbour> neighbours, unsigned int) {
+        if (neighbours.empty())
+            return;
+        double mass = 0.0;
+        for (const auto &neighbour : neighbours)
+            mass += masses[neighbour.index];
+        double radius = std::sqrt(neighbours.back().distance2);
+        densities[index] = radius > 0 ? mass / (4.0 / 3.0 * M_PI * radius * radius * radius) : 0.0;
+    });
+    return densities;
+}
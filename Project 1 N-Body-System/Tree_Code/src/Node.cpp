@@ -1,27 +1,87 @@
 #include <Eigen/Dense>
 #include <Eigen/Core>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <math.h>
 #include "Planet.hpp"
 #include "Node.hpp"
 
 using std::vector;
 using Eigen::Vector3d;
 
+namespace
+{
+    // the factors of the short range kernel only depend on u = r / (2 r_s), so one table serves every split radius
+    // potential: erfc(u), force: erfc(u) + 2 u / sqrt(pi) exp(-u^2), both are below 2e-8 after u = 4
+    struct ShortRangeTable
+    {
+        static constexpr int size = 4096;
+        static constexpr double u_max = 4.0;
+        double potential[size + 1];
+        double force[size + 1];
+
+        ShortRangeTable()
+        {
+            for (int i = 0; i <= size; i++) {
+                double u = u_max * i / size;
+                potential[i] = std::erfc(u);
+                force[i] = std::erfc(u) + 2 * u / std::sqrt(M_PI) * std::exp(-u * u);
+            }
+        }
+
+        // linear interpolation, much cheaper than erfc and exp for every interaction
+        void lookup(double u, double & potential_factor, double & force_factor) const
+        {
+            double x = u * (size / u_max);
+            if (x >= size) {
+                potential_factor = force_factor = 0.0;
+                return;
+            }
+            int i = static_cast<int>(x);
+            double f = x - i;
+            potential_factor = potential[i] + f * (potential[i + 1] - potential[i]);
+            force_factor = force[i] + f * (force[i + 1] - force[i]);
+        }
+    };
+
+    const ShortRangeTable & short_range_table()
+    {
+        static const ShortRangeTable table;
+        return table;
+    }
+}
+
+
+void Node::subdivide(const std::vector<Planet> & planets)
+{
+    vector<std::size_t> indices(planets.size());
+    for (std::size_t i = 0; i < indices.size(); i++) indices[i] = i;
+    subdivide(planets, indices);
+}
 
 // implement the actuall interesting function
-void Node::subdivide(std::vector<Planet> & planets)
+void Node::subdivide(const std::vector<Planet> & planets, const std::vector<std::size_t> & indices)
 {
     // implementation of the subdivision into 8 child nodes
     // first we need to check if we actually need to subdivide
-    if (planets.size() <= limit){
+    if (planets.size() <= static_cast<std::size_t>(limit) || depth >= max_depth){
         is_leaf = true;
         this->planets = planets;
+        this->indices = indices;
+
+        // compute the multipoles right away, so the tree walks afterwards only read
+        _compute_total_mass();
+        _compute_com();
+        _compute_Q();
         return;
     }
-    
+    is_leaf = false;
+
 
     // at first we need to determine in which quadrant each planet goes
     vector<vector<Planet>> quadrant_planets(8);
+    vector<vector<std::size_t>> quadrant_indices(8);
     auto center = center_position();
     auto half_diagonal = (diag_one - diag_two).norm() / 2;
 
@@ -50,7 +110,9 @@ void Node::subdivide(std::vector<Planet> & planets)
 
 
     // now we can put all planets into their respective quadrants
-    for (const auto& planet : planets) {
+    for (std::size_t k = 0; k < planets.size(); k++) {
+        const Planet & planet = planets[k];
+
         // compute position relative to center
         Vector3d relative_pos = planet.position - center;
 
@@ -61,8 +123,12 @@ void Node::subdivide(std::vector<Planet> & planets)
         if (relative_pos[2] >= 0) octant += 1; // +z
 
         quadrant_planets[octant].push_back(planet);
+        quadrant_indices[octant].push_back(indices[k]);
     }
 
+    // reserving avoids that the vector moves already built subtrees around
+    this->children.reserve(8);
+
     // now that all the planets are groupes we need to create the planets
     for (int i = 0; i < 8; ++i) {
         // if the quadrant is empty, we don't create a child
@@ -77,11 +143,403 @@ void Node::subdivide(std::vector<Planet> & planets)
             limit,
             depth + 1,
             G,
-            theta
+            theta,
+            softening,
+            quadrupole
         );
+        this->children.back().subdivide(quadrant_planets[i], quadrant_indices[i]);
+
+        // the planets of this octant are now stored in the subtree
+        quadrant_planets[i].clear();
+        quadrant_planets[i].shrink_to_fit();
+        quadrant_indices[i].clear();
+        quadrant_indices[i].shrink_to_fit();
+    }
+
+    // the children are complete, so the multipoles of this node can be computed
+    _compute_total_mass();
+    _compute_com();
+    _compute_Q();
+}
+
+Node Node::build(const std::vector<Planet> & planets, int limit_, double G_, double theta_, double softening_, bool quadrupole_)
+{
+    // find the largest coordinate, so the cube contains all planets
+    double extent = 0.0;
+    for (const auto& planet : planets) {
+        extent = std::max(extent, planet.position.cwiseAbs().maxCoeff());
+    }
+
+    // a small margin, so no planet lies exactly on the boundary
+    extent = extent * (1 + 1e-6) + 1e-12;
+
+    Node root(
+        Vector3d(-extent, -extent, -extent),
+        Vector3d( extent,  extent,  extent),
+        limit_,
+        0,
+        G_,
+        theta_,
+        softening_,
+        quadrupole_
+    );
+    root.subdivide(planets);
+    return root;
+}
+
+void Node::set_opening(double theta_, bool quadrupole_)
+{
+    theta = theta_;
+    quadrupole = quadrupole_;
+    for (auto& child : children) {
+        child.set_opening(theta_, quadrupole_);
+    }
+}
+
+Eigen::Vector3d Node::compute_acceleration(const Planet & p) const
+{
+    Vector3d acceleration = Vector3d::Zero();
+
+    if (is_leaf) {
+        // direct summation over the planets in the leaf
+        for (const auto& other : planets) {
+            Vector3d r = p.position - other.position;
+            double r2 = r.squaredNorm();
+
+            // this excludes the attraction to one self
+            if (r2 == 0.0) continue;
+
+            double r2_soft = r2 + softening * softening;
+            acceleration += -G * other.mass * r / (r2_soft * std::sqrt(r2_soft));
+        }
+        return acceleration;
+    }
+
+    // vector from the center of mass to the planet
+    Vector3d y = p.position - com();
+    double y_mag = y.norm();
+
+    // Barnes-Hut criterion: is the node small enough as seen from the planet?
+    if (y_mag > 0.0 && expansion_coefficient() / y_mag < theta) {
+        double y2 = y_mag * y_mag;
+        double y3 = y2 * y_mag;
+
+        // monopole term
+        Vector3d a_mono = -G * total_mass() * y / y3;
+        if (!quadrupole) return a_mono;
+
+        // quadrupole term, the gradient of - G / 2 * y^T Q y / |y|^5
+        double y5 = y3 * y2;
+        double y7 = y5 * y2;
+        Vector3d Qy = Q() * y;
+        double yQy = y.dot(Qy);
+        Vector3d a_quad = G * (Qy / y5 - y * (2.5 * yQy / y7));
+
+        return a_mono + a_quad;
+    }
+
+    // otherwise we have to open the node
+    for (auto& child : children) {
+        acceleration += child.compute_acceleration(p);
+    }
+    return acceleration;
+}
+
+double Node::compute_potential(const Planet & p) const
+{
+    Vector3d acceleration = Vector3d::Zero();
+    double potential = 0.0;
+    compute_acceleration_and_potential(p, acceleration, potential);
+    return potential;
+}
+
+void Node::compute_acceleration_and_potential(const Planet & p, Eigen::Vector3d & acceleration, double & potential) const
+{
+    if (is_leaf) {
+        for (const auto& other : planets) {
+            Vector3d r = p.position - other.position;
+            double r2 = r.squaredNorm();
+            if (r2 == 0.0) continue;
+
+            double r2_soft = r2 + softening * softening;
+            double inverse_r = 1.0 / std::sqrt(r2_soft);
+            acceleration += -G * other.mass * r * (inverse_r * inverse_r * inverse_r);
+            potential += -G * other.mass * inverse_r;
+        }
+        return;
+    }
+
+    Vector3d y = p.position - com();
+    double y_mag = y.norm();
+
+    if (y_mag > 0.0 && expansion_coefficient() / y_mag < theta) {
+        double y2 = y_mag * y_mag;
+        double y3 = y2 * y_mag;
+        if (!quadrupole) {
+            acceleration += -G * total_mass() * y / y3;
+            potential += -G * total_mass() / y_mag;
+            return;
+        }
+        double y5 = y3 * y2;
+        double y7 = y5 * y2;
+
+        Vector3d Qy = Q() * y;
+        double yQy = y.dot(Qy);
+
+        // phi = - G M / |y| - G / 2 * y^T Q y / |y|^5, the acceleration is its negative gradient
+        acceleration += -G * total_mass() * y / y3 + G * (Qy / y5 - y * (2.5 * yQy / y7));
+        potential += -G * (total_mass() / y_mag + 0.5 * yQy / y5);
+        return;
+    }
+
+    for (auto& child : children) {
+        child.compute_acceleration_and_potential(p, acceleration, potential);
+    }
+}
+
+void Node::compute_field(const std::vector<Eigen::Vector3d> & points, const Eigen::Vector3d & lower, const Eigen::Vector3d & upper, std::vector<Eigen::Vector3d> & accelerations, std::vector<double> & potentials) const
+{
+    std::vector<std::size_t> active(points.size());
+    for (std::size_t m = 0; m < points.size(); m++) active[m] = m;
+    _field_walk(points, active, lower, upper, accelerations, potentials);
+}
+
+void Node::_field_walk(const std::vector<Eigen::Vector3d> & points, const std::vector<std::size_t> & active, const Eigen::Vector3d & lower, const Eigen::Vector3d & upper, std::vector<Eigen::Vector3d> & accelerations, std::vector<double> & potentials) const
+{
+    if (is_leaf) {
+        for (std::size_t m : active) {
+            for (const auto& other : planets) {
+                Vector3d r = points[m] - other.position;
+                double r2 = r.squaredNorm();
+                if (r2 == 0.0) continue;
+
+                double r2_soft = r2 + softening * softening;
+                double inverse_r = 1.0 / std::sqrt(r2_soft);
+                accelerations[m] += -G * other.mass * r * (inverse_r * inverse_r * inverse_r);
+                potentials[m] += -G * other.mass * inverse_r;
+            }
+        }
+        return;
+    }
+
+    const Vector3d center_of_mass = com();
+    const double size = expansion_coefficient();
+    const Eigen::Matrix3d quadrupole_moment = Q();
+    auto add_multipoles = [&](std::size_t m, const Vector3d & y, double y_mag) {
+        double y2 = y_mag * y_mag;
+        double y3 = y2 * y_mag;
+        if (!quadrupole) {
+            accelerations[m] += -G * total_mass() * y / y3;
+            potentials[m] += -G * total_mass() / y_mag;
+            return;
+        }
+        double y5 = y3 * y2;
+        double y7 = y5 * y2;
+
+        Vector3d Qy = quadrupole_moment * y;
+        double yQy = y.dot(Qy);
+
+        accelerations[m] += -G * total_mass() * y / y3 + G * (Qy / y5 - y * (2.5 * yQy / y7));
+        potentials[m] += -G * (total_mass() / y_mag + 0.5 * yQy / y5);
+    };
+
+    // the criterion with the point of the group which is closest to the center of mass
+    Vector3d outside = (lower - center_of_mass).cwiseMax(0.0) + (center_of_mass - upper).cwiseMax(0.0);
+    double closest = outside.norm();
+
+    if (closest > 0.0 && size / closest < theta) {
+        for (std::size_t m : active) {
+            Vector3d y = points[m] - center_of_mass;
+            add_multipoles(m, y, y.norm());
+        }
+        return;
+    }
+
+    // otherwise the points which are far enough on their own take the multipoles here,
+    // only the others go on to the children
+    std::vector<std::size_t> remaining;
+    remaining.reserve(active.size());
+    for (std::size_t m : active) {
+        Vector3d y = points[m] - center_of_mass;
+        double y_mag = y.norm();
+        if (y_mag > 0.0 && size / y_mag < theta) add_multipoles(m, y, y_mag);
+        else remaining.push_back(m);
+    }
+    if (remaining.empty()) return;
+
+    // the box around the remaining points is smaller, which makes the criterion of the children sharper
+    Vector3d remaining_lower = points[remaining[0]];
+    Vector3d remaining_upper = points[remaining[0]];
+    for (std::size_t m : remaining) {
+        remaining_lower = remaining_lower.cwiseMin(points[m]);
+        remaining_upper = remaining_upper.cwiseMax(points[m]);
+    }
+    for (auto& child : children) {
+        child._field_walk(points, remaining, remaining_lower, remaining_upper, accelerations, potentials);
+    }
+}
+
+void Node::compute_acceleration_and_neighbours(const Planet & p, double radius, Eigen::Vector3d & acceleration, double & potential, std::vector<Neighbour> & neighbours) const
+{
+    const double radius2 = radius * radius;
+
+    if (is_leaf) {
+        for (std::size_t k = 0; k < planets.size(); k++) {
+            Vector3d r = p.position - planets[k].position;
+            double r2 = r.squaredNorm();
+            if (r2 <= radius2) neighbours.push_back({indices[k], r2});
+            if (r2 == 0.0) continue;
+
+            double r2_soft = r2 + softening * softening;
+            double inverse_r = 1.0 / std::sqrt(r2_soft);
+            acceleration += -G * planets[k].mass * r * (inverse_r * inverse_r * inverse_r);
+            potential += -G * planets[k].mass * inverse_r;
+        }
+        return;
+    }
+
+    // a node which reaches into the search sphere has to be opened, even if the multipoles would be good enough
+    Vector3d lower = diag_one.cwiseMin(diag_two);
+    Vector3d upper = diag_one.cwiseMax(diag_two);
+    Vector3d outside = (lower - p.position).cwiseMax(0.0) + (p.position - upper).cwiseMax(0.0);
+    bool may_contain_neighbours = outside.squaredNorm() <= radius2;
+
+    Vector3d y = p.position - com();
+    double y_mag = y.norm();
+
+    if (!may_contain_neighbours && y_mag > 0.0 && expansion_coefficient() / y_mag < theta) {
+        double y2 = y_mag * y_mag;
+        double y3 = y2 * y_mag;
+        if (!quadrupole) {
+            acceleration += -G * total_mass() * y / y3;
+            potential += -G * total_mass() / y_mag;
+            return;
+        }
+        double y5 = y3 * y2;
+        double y7 = y5 * y2;
+
+        Vector3d Qy = Q() * y;
+        double yQy = y.dot(Qy);
+
+        acceleration += -G * total_mass() * y / y3 + G * (Qy / y5 - y * (2.5 * yQy / y7));
+        potential += -G * (total_mass() / y_mag + 0.5 * yQy / y5);
+        return;
+    }
+
+    for (auto& child : children) {
+        child.compute_acceleration_and_neighbours(p, radius, acceleration, potential, neighbours);
     }
 }
 
+void Node::compute_short_range_acceleration_and_potential(const Planet & p, double split_radius, double cutoff, Eigen::Vector3d & acceleration, double & potential) const
+{
+    // the shortest distance between the planet and the box of this node
+    Vector3d lower = diag_one.cwiseMin(diag_two);
+    Vector3d upper = diag_one.cwiseMax(diag_two);
+    Vector3d outside = (lower - p.position).cwiseMax(0.0) + (p.position - upper).cwiseMax(0.0);
+    if (outside.squaredNorm() > cutoff * cutoff) return;
+
+    // the short range kernel is the newtonian one times the factors of the table
+    const ShortRangeTable & table = short_range_table();
+    const double inverse_split = 1.0 / (2 * split_radius);
+    auto add = [&](const Vector3d & r, double r_mag, double mass) {
+        double potential_factor, force_factor;
+        table.lookup(r_mag * inverse_split, potential_factor, force_factor);
+        acceleration += -G * mass * force_factor * r / (r_mag * r_mag * r_mag);
+        potential += -G * mass * potential_factor / r_mag;
+    };
+
+    if (is_leaf) {
+        for (const auto& other : planets) {
+            Vector3d r = p.position - other.position;
+            double r2 = r.squaredNorm();
+            if (r2 == 0.0) continue;
+
+            // with softening r / |r|^3 becomes r / (r^2 + eps^2)^(3/2)
+            add(r, std::sqrt(r2 + softening * softening), other.mass);
+        }
+        return;
+    }
+
+    Vector3d y = p.position - com();
+    double y_mag = y.norm();
+
+    if (y_mag > 0.0 && expansion_coefficient() / y_mag < theta) {
+        add(y, y_mag, total_mass());
+        return;
+    }
+
+    for (auto& child : children) {
+        child.compute_short_range_acceleration_and_potential(p, split_radius, cutoff, acceleration, potential);
+    }
+}
+
+void Node::compute_periodic_acceleration_and_potential(const Planet & p, const PeriodicBox & box, Eigen::Vector3d & acceleration, double & potential) const
+{
+    _periodic_walk(p, box, acceleration, potential, false);
+}
+
+void Node::_periodic_walk(const Planet & p, const PeriodicBox & box, Eigen::Vector3d & acceleration, double & potential, bool images_added) const
+{
+    Vector3d y = box.minimum_image(p.position - com());
+    double y_mag = y.norm();
+
+    // the ewald correction only changes on the scale of the box, so one lookup at the com of a node
+    // smaller than a quarter of the box is enough for all of its planets (the error is second order
+    // in the size of the node). Its children then only add the nearest images
+    bool accepted = is_leaf || (y_mag > 0.0 && expansion_coefficient() / y_mag < theta);
+    if (!images_added && (accepted || (diag_one - diag_two).cwiseAbs().maxCoeff() <= box.size() / 4)) {
+        // the images of the planet itself are left out, as in the direct summation
+        Vector3d lower = diag_one.cwiseMin(diag_two);
+        Vector3d upper = diag_one.cwiseMax(diag_two);
+        bool inside = (p.position.array() >= lower.array()).all() && (p.position.array() <= upper.array()).all();
+        double mass = inside ? total_mass() - p.mass : total_mass();
+
+        Vector3d force;
+        double correction;
+        box.correction(y, force, correction);
+        acceleration += G * mass * force;
+        potential += G * mass * correction;
+        images_added = true;
+    }
+
+    if (is_leaf) {
+        for (const auto& other : planets) {
+            Vector3d r = box.minimum_image(p.position - other.position);
+            double r2 = r.squaredNorm();
+            if (r2 == 0.0) continue;
+
+            double r2_soft = r2 + softening * softening;
+            double inverse_r = 1.0 / std::sqrt(r2_soft);
+            acceleration += -G * other.mass * r * (inverse_r * inverse_r * inverse_r);
+            potential += -G * other.mass * inverse_r;
+        }
+        return;
+    }
+
+    if (accepted) {
+        double y2 = y_mag * y_mag;
+        double y3 = y2 * y_mag;
+        if (!quadrupole) {
+            acceleration += -G * total_mass() * y / y3;
+            potential += -G * total_mass() / y_mag;
+            return;
+        }
+        double y5 = y3 * y2;
+        double y7 = y5 * y2;
+
+        Vector3d Qy = Q() * y;
+        double yQy = y.dot(Qy);
+
+        acceleration += -G * total_mass() * y / y3 + G * (Qy / y5 - y * (2.5 * yQy / y7));
+        potential += -G * (total_mass() / y_mag + 0.5 * yQy / y5);
+        return;
+    }
+
+    for (auto& child : children) {
+        child._periodic_walk(p, box, acceleration, potential, images_added);
+    }
+}
 
 
 // implementation of the private compute functions
@@ -102,7 +560,6 @@ double Node::_compute_total_mass()
         }
     }
     
-    _total_mass_flag = true;
     return _total_mass;
 }
 
@@ -113,7 +570,6 @@ Eigen::Vector3d Node::_compute_com()
     
     // If node is empty, return zero
     if (total_mass_val == 0.0) {
-        _com_flag = true;
         return _com;
     }
     
@@ -132,7 +588,6 @@ Eigen::Vector3d Node::_compute_com()
     // Normalize by total mass
     _com /= total_mass_val;
     
-    _com_flag = true;
     return _com;
 }
 
@@ -141,7 +596,6 @@ Eigen::Vector3d Node::_compute_center_position()
     // The center position is simply the geometric center of the node's bounding box
 
     _center_position = (diag_one + diag_two) / 2.0;
-    _center_position_flag = true;
     return _center_position;
 }
 
@@ -152,37 +606,32 @@ double Node::_compute_expansion_coefficient()
     Eigen::Vector3d extent = diag_one - diag_two;
     _expansion_coefficient = extent.norm() / 2.0;
     
-    _expansion_coefficient_flag = true;
     return _expansion_coefficient;
 }
 
 Eigen::Matrix3d Node::_compute_Q()
 {
+    // Q is not normalized by the mass, so it can directly be used in the force expansion
     _Q = Eigen::Matrix3d::Zero();
     Eigen::Matrix3d identity = Eigen::Matrix3d::Identity();
-    double total_mass_val = total_mass();
     
     if (this->is_leaf) {
-        for (auto p : this->planets) {
+        for (const auto & p : this->planets) {
             double m = p.mass;
             Eigen::Vector3d r = p.position - this->com();
             double r_mag = r.norm();
             _Q += m * (3 * r * r.transpose() - r_mag * r_mag * identity);
         }
     } else {
+        // the quadrupole of a child around our com is its own quadrupole
+        // plus the one of a point mass at the com of the child (parallel axis theorem)
         for (auto & c : this->children) {
             double m = c.total_mass();
             Eigen::Vector3d r = c.com() - this->com();
             double r_mag = r.norm();
-            _Q += m * (3 * r * r.transpose() - r_mag * r_mag * identity);
+            _Q += c.Q() + m * (3 * r * r.transpose() - r_mag * r_mag * identity);
         }
     }
     
-    // Normalize by total mass
-    if (total_mass_val > 0.0) {
-        _Q /= total_mass_val;
-    }
-    
-    _Q_flag = true;
     return _Q;
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "PairCounter.hpp"
+
+PairCounter::PairCounter(double r_min, double r_max, std::size_t n_bins, unsigned int n_threads)
+    : _n_bins(std::max<std::size_t>(n_bins, 1)), _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    double log_r_min = std::log(r_min);
+    double log_step = (std::log(r_max) - log_r_min) / _n_bins;
+    for (std::size_t k = 0; k <= _n_bins; k++)
+    {
+        double edge = k == _n_bins ? r_max : std::exp(log_r_min + k * log_step);
+        _edges.push_back(edge);
+        _edges2.push_back(edge * edge);
+    }
+    _counts.assign(_n_bins, 0.0);
+}
+
+long PairCounter::_bin(double distance2) const
+{
+    return static_cast<long>(std::upper_bound(_edges2.begin(), _edges2.end(), distance2) - _edges2.begin()) - 1;
+}
+
+PairCounter::FlatTree PairCounter::_flatten(const Node &tree)
+{
+    FlatTree flat;
+    flat.cells.resize(1);
+    _flatten(tree, 0, flat);
+    return flat;
+}
+
+void PairCounter::_flatten(const Node &node, std::size_t index, FlatTree &flat)
+{
+    if (node.leaf())
+    {
+        Cell cell{Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), node.leaf_planets().size(), flat.positions.size(), 0};
+        for (const auto &planet : node.leaf_planets())
+            flat.positions.push_back(planet.position);
+        if (cell.n_planets > 0)
+        {
+            cell.lower = flat.positions[cell.first];
+            cell.upper = flat.positions[cell.first];
+            for (std::size_t j = cell.first; j < flat.positions.size(); j++)
+            {
+                cell.lower = cell.lower.cwiseMin(flat.positions[j]);
+                cell.upper = cell.upper.cwiseMax(flat.positions[j]);
+            }
+        }
+        flat.cells[index] = cell;
+        return;
+    }
+
+    // the children get their places first, so they are next to each other
+    const auto &children = node.child_nodes();
+    std::size_t first = flat.cells.size();
+    flat.cells.resize(first + children.size());
+    for (std::size_t c = 0; c < children.size(); c++)
+        _flatten(children[c], first + c, flat);
+
+    // flat.cells may have moved, so the cell is only written at the end
+    Cell cell{flat.cells[first].lower, flat.cells[first].upper, 0, first, children.size()};
+    for (std::size_t c = first; c < first + children.size(); c++)
+    {
+        cell.lower = cell.lower.cwiseMin(flat.cells[c].lower);
+        cell.upper = cell.upper.cwiseMax(flat.cells[c].upper);
+        cell.n_planets += flat.cells[c].n_planets;
+    }
+    flat.cells[index] = cell;
+}
+
+const std::vector<double> &PairCounter::count(const Node &tree)
+{
+    FlatTree flat = _flatten(tree);
+    return _count(flat, flat, true);
+}
+
+const std::vector<double> &PairCounter::count(const Node &tree_a, const Node &tree_b)
+{
+    FlatTree flat_a = _flatten(tree_a);
+    FlatTree flat_b = _flatten(tree_b);
+    return _count(flat_a, flat_b, false);
+}
+
+const std::vector<double> &PairCounter::_count(const FlatTree &tree_a, const FlatTree &tree_b, bool same)
+{
+    _histograms.assign((_n_threads + 1) * _n_bins, 0.0);
+    _counts.assign(_n_bins, 0.0);
+    if (tree_a.positions.empty() || tree_b.positions.empty())
+        return _counts;
+
+    // the node pairs are split until there are enough of them to keep all threads busy
+    // what is already resolved on the way goes into the last histogram
+    double *serial_histogram = _histograms.data() + _n_threads * _n_bins;
+    std::vector<Task> tasks = {{0, 0, same}};
+    std::vector<Task> next;
+    const std::size_t target = 64 * static_cast<std::size_t>(_n_threads);
+    while (!tasks.empty() && tasks.size() < target)
+    {
+        next.clear();
+        for (const auto &task : tasks)
+            _count_pair(tree_a, tree_b, task, serial_histogram, &next);
+        tasks.swap(next);
+    }
+
+    // the tasks differ a lot in cost and neighbouring ones are similar, so they are dealt out in turns
+    parallel_for(_n_threads, [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t thread = begin; thread < end; thread++)
+        {
+            double *histogram = _histograms.data() + thread * _n_bins;
+            for (std::size_t t = thread; t < tasks.size(); t += _n_threads)
+                _count_pair(tree_a, tree_b, tasks[t], histogram, nullptr);
+        }
+    }, _n_threads);
+
+    for (std::size_t thread = 0; thread <= _n_threads; thread++)
+        for (std::size_t k = 0; k < _n_bins; k++)
+            _counts[k] += _histograms[thread * _n_bins + k];
+    return _counts;
+}
+
+void PairCounter::_count_pair(const FlatTree &tree_a, const FlatTree &tree_b, const Task &task, double *histogram, std::vector<Task> *split) const
+{
+    const Cell &a = tree_a.cells[task.a];
+    const Cell &b = tree_b.cells[task.b];
+
+    // the smallest and largest distance of any two points of the boxes
+    double min_distance2 = ((b.lower - a.upper).cwiseMax(0.0) + (a.lower - b.upper).cwiseMax(0.0)).squaredNorm();
+    double max_distance2 = (b.upper - a.lower).cwiseAbs().cwiseMax((a.upper - b.lower).cwiseAbs()).squaredNorm();
+    long lowest = _bin(min_distance2);
+    long highest = _bin(max_distance2);
+    if (lowest >= static_cast<long>(_n_bins) || highest < 0)
+        return;
+
+    // all pairs fall into the same bin
+    if (lowest == highest)
+    {
+        double n_a = static_cast<double>(a.n_planets);
+        histogram[lowest] += task.same ? n_a * (n_a - 1) / 2 : n_a * static_cast<double>(b.n_planets);
+        return;
+    }
+
+    if (a.n_children == 0 && b.n_children == 0)
+    {
+        // only the edges between the lowest and highest bin of the two leaves have to be searched
+        const double *edges_begin = _edges2.data() + std::max(lowest, 0L);
+        const double *edges_end = _edges2.data() + std::min(highest + 1, static_cast<long>(_n_bins)) + 1;
+        for (std::size_t i = a.first; i < a.first + a.n_planets; i++)
+        {
+            const Eigen::Vector3d &x = tree_a.positions[i];
+            std::size_t j_begin = task.same ? i + 1 : b.first;
+            for (std::size_t j = j_begin; j < b.first + b.n_planets; j++)
+            {
+                double distance2 = (tree_b.positions[j] - x).squaredNorm();
+                long bin = std::upper_bound(edges_begin, edges_end, distance2) - _edges2.data() - 1;
+                if (bin >= 0 && bin < static_cast<long>(_n_bins))
+                    histogram[bin] += 1.0;
+            }
+        }
+        return;
+    }
+
+    auto visit = [&](std::size_t cell_a, std::size_t cell_b, bool same) {
+        if (split != nullptr)
+            split->push_back({cell_a, cell_b, same});
+        else
+            _count_pair(tree_a, tree_b, {cell_a, cell_b, same}, histogram, nullptr);
+    };
+
+    // a cell with itself: every child with itself and every pair of children once
+    if (task.same)
+    {
+        for (std::size_t c = a.first; c < a.first + a.n_children; c++)
+        {
+            visit(c, c, true);
+            for (std::size_t d = c + 1; d < a.first + a.n_children; d++)
+                visit(c, d, false);
+        }
+        return;
+    }
+
+    // otherwise the larger cell is split
+    bool split_a = b.n_children == 0 || (a.n_children > 0 && (a.upper - a.lower).squaredNorm() >= (b.upper - b.lower).squaredNorm());
+    if (split_a)
+        for (std::size_t c = a.first; c < a.first + a.n_children; c++)
+            visit(c, task.b, false);
+    else
+        for (std::size_t c = b.first; c < b.first + b.n_children; c++)
+            visit(task.a, c, false);
+}
+
+std::vector<double> PairCounter::landy_szalay(const std::vector<double> &dd, const std::vector<double> &dr, const std::vector<double> &rr,
+                                              std::size_t n_data, std::size_t n_random)
+{
+    double n_d = static_cast<double>(n_data);
+    double n_r = static_cast<double>(n_random);
+    double dd_pairs = n_d * (n_d - 1) / 2;
+    double dr_pairs = n_d * n_r;
+    double rr_pairs = n_r * (n_r - 1) / 2;
+
+    std::vector<double> xi(dd.size(), 0.0);
+    for (std::size_t k = 0; k < dd.size(); k++)
+    {
+        double rr_k = rr[k] / rr_pairs;
+        if (rr_k > 0)
+            xi[k] = (dd[k] / dd_pairs - 2 * dr[k] / dr_pairs + rr_k) / rr_k;
+    }
+    return xi;
+}
+
+std::vector<double> PairCounter::correlation_function(const std::vector<Planet> &data, const std::vector<Planet> &randoms, int limit)
+{
+    // G and theta do not matter, only the structure of the trees is used
+    FlatTree data_tree = _flatten(Node::build(data, limit, 1.0, 0.5));
+    FlatTree random_tree = _flatten(Node::build(randoms, limit, 1.0, 0.5));
+
+    std::vector<double> dd = _count(data_tree, data_tree, true);
+    std::vector<double> dr = _count(data_tree, random_tree, false);
+    std::vector<double> rr = _count(random_tree, random_tree, true);
+    return landy_szalay(dd, dr, rr, data.size(), randoms.size());
+}
+
+void PairCounter::export_to_file(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    file << "r_inner;r_outer;r_center;count\n";
+    file.precision(10);
+    for (std::size_t k = 0; k < _n_bins; k++)
+        file << _edges[k] << ";" << _edges[k + 1] << ";" << std::sqrt(_edges[k] * _edges[k + 1]) << ";" << _counts[k] << "\n";
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <span>
+#include <vector>
+#include <math.h>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Parallel.hpp"
+#include "ParticleMesh.hpp"
+
+ParticleMesh::ParticleMesh(std::size_t n_mesh, double G, double split, MassAssignment assignment, unsigned int n_threads)
+    : _n(std::max<std::size_t>(n_mesh, 16)), _G(G), _split(split), _assignment(assignment),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count()), _fft(2 * _n)
+{}
+
+bool ParticleMesh::_fit_mesh(std::span<const Planet> planets)
+{
+    double extent = 0.0;
+    for (const auto &planet : planets)
+        extent = std::max(extent, planet.position.cwiseAbs().maxCoeff());
+
+    // the planets have to stay 4 mesh points away from the border, so the mass assignment
+    // and the finite differences never reach outside of the mesh
+    const double usable = (_n - 9) / 2.0;
+    double current_extent = _spacing * usable;
+    if (_spacing > 0 && extent <= current_extent && extent > 0.5 * current_extent)
+        return false;
+
+    // some room to grow, so the kernel does not have to be transformed again every step
+    _spacing = std::max(extent * 1.25, 1e-12) / usable;
+    _corner = Eigen::Vector3d::Constant(-_spacing * (_n / 2.0));
+    return true;
+}
+
+void ParticleMesh::_transform_kernel()
+{
+    const std::size_t M = 2 * _n;
+    const double r_s = split_radius();
+
+    _kernel.assign(M * M * M, 0.0);
+    for (std::size_t x = 0; x < M; x++)
+    {
+        for (std::size_t y = 0; y < M; y++)
+        {
+            for (std::size_t z = 0; z < M; z++)
+            {
+                // the distance of the mesh point, negative distances lie in the upper half
+                auto distance = [M](std::size_t k) { return k <= M / 2 ? static_cast<double>(k) : static_cast<double>(k) - M; };
+                double r = _spacing * std::sqrt(distance(x) * distance(x) + distance(y) * distance(y) + distance(z) * distance(z));
+
+                double kernel = (r > 0) ? -_G * std::erf(r / (2 * r_s)) / r : -_G / (r_s * std::sqrt(M_PI));
+                _kernel[(x * M + y) * M + z] = kernel / static_cast<double>(M * M * M);
+            }
+        }
+    }
+    _fft.transform_3d(_kernel, false, _n_threads);
+}
+
+int ParticleMesh::_weights(const Eigen::Vector3d &position, long index[3][3], double weight[3][3]) const
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double u = (position(axis) - _corner(axis)) / _spacing;
+        if (_assignment == MassAssignment::cic)
+        {
+            long i = static_cast<long>(std::floor(u));
+            double f = u - i;
+            index[axis][0] = i;
+            index[axis][1] = i + 1;
+            weight[axis][0] = 1 - f;
+            weight[axis][1] = f;
+        }
+        else
+        {
+            long i = std::lround(u);
+            double d = u - i;
+            index[axis][0] = i - 1;
+            index[axis][1] = i;
+            index[axis][2] = i + 1;
+            weight[axis][0] = 0.5 * (0.5 - d) * (0.5 - d);
+            weight[axis][1] = 0.75 - d * d;
+            weight[axis][2] = 0.5 * (0.5 + d) * (0.5 + d);
+        }
+    }
+    return _assignment == MassAssignment::cic ? 2 : 3;
+}
+
+void ParticleMesh::add_long_range(std::span<const Planet> planets, std::vector<Eigen::Vector3d> &accelerations, std::vector<double> &potentials)
+{
+    if (_fit_mesh(planets))
+        _transform_kernel();
+
+    const std::size_t n = _n;
+    const std::size_t M = 2 * n;
+
+    // every thread puts its planets onto its own mesh, which are added up in order afterwards
+    std::vector<std::vector<double>> masses(_n_threads);
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        masses[thread].assign(n * n * n, 0.0);
+        double *mesh = masses[thread].data();
+        long index[3][3];
+        double weight[3][3];
+        for (std::size_t k = begin; k < end; k++)
+        {
+            int points = _weights(planets[k].position, index, weight);
+            for (int a = 0; a < points; a++)
+                for (int b = 0; b < points; b++)
+                    for (int c = 0; c < points; c++)
+                        mesh[(index[0][a] * n + index[1][b]) * n + index[2][c]] += planets[k].mass * weight[0][a] * weight[1][b] * weight[2][c];
+        }
+    }, _n_threads);
+
+    _padded.assign(M * M * M, 0.0);
+    for (const auto &mesh : masses)
+    {
+        if (mesh.empty())
+            continue;
+        for (std::size_t x = 0; x < n; x++)
+            for (std::size_t y = 0; y < n; y++)
+                for (std::size_t z = 0; z < n; z++)
+                    _padded[(x * M + y) * M + z] += mesh[(x * n + y) * n + z];
+    }
+
+    // the convolution with the kernel is a product after the transform
+    // only the first n points along every axis hold mass and only there the potential is needed
+    _fft.transform_3d(_padded, false, _n_threads, n);
+    for (std::size_t i = 0; i < _padded.size(); i++)
+        _padded[i] *= _kernel[i];
+    _fft.transform_3d(_padded, true, _n_threads, n);
+
+    _potential.resize(n * n * n);
+    for (std::size_t x = 0; x < n; x++)
+        for (std::size_t y = 0; y < n; y++)
+            for (std::size_t z = 0; z < n; z++)
+                _potential[(x * n + y) * n + z] = _padded[(x * M + y) * M + z].real();
+
+    // the acceleration on the mesh with the 4 point finite difference of the potential
+    _acceleration.assign(n * n * n, Eigen::Vector3d::Zero());
+    const long strides[3] = {static_cast<long>(n * n), static_cast<long>(n), 1};
+    for (std::size_t x = 2; x < n - 2; x++)
+    {
+        for (std::size_t y = 2; y < n - 2; y++)
+        {
+            for (std::size_t z = 2; z < n - 2; z++)
+            {
+                long i = (x * n + y) * n + z;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    long s = strides[axis];
+                    double gradient = (8 * (_potential[i + s] - _potential[i - s]) - (_potential[i + 2 * s] - _potential[i - 2 * s])) / (12 * _spacing);
+                    _acceleration[i](axis) = -gradient;
+                }
+            }
+        }
+    }
+
+    // back to the planets with the same weights, so a planet does not pull on itself
+    // the potential of its own smoothed mass is removed approximately with the value of the kernel at 0
+    const double self_potential = -_G / (split_radius() * std::sqrt(M_PI));
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        long index[3][3];
+        double weight[3][3];
+        for (std::size_t k = begin; k < end; k++)
+        {
+            int points = _weights(planets[k].position, index, weight);
+            Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+            double potential = 0.0;
+            for (int a = 0; a < points; a++)
+            {
+                for (int b = 0; b < points; b++)
+                {
+                    for (int c = 0; c < points; c++)
+                    {
+                        long i = (index[0][a] * n + index[1][b]) * n + index[2][c];
+                        double w = weight[0][a] * weight[1][b] * weight[2][c];
+                        acceleration += w * _acceleration[i];
+                        potential += w * _potential[i];
+                    }
+                }
+            }
+            accelerations[k] += acceleration;
+            potentials[k] += potential - planets[k].mass * self_potential;
+        }
+    }, _n_threads);
+}
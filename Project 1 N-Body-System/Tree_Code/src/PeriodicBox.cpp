@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <Eigen/Dense>
+#include "Parallel.hpp"
+#include "PeriodicBox.hpp"
+
+namespace
+{
+    const char ewald_magic[8] = {'N', 'B', 'E', 'W', 'A', 'L', 'D', '2'};
+
+    // the split between real and reciprocal space sum in units of 1 / L, 2 needs only few terms of both
+    constexpr double alpha = 2.0;
+    constexpr int real_images = 4;
+    constexpr int reciprocal_vectors = 4;
+
+    // the correction of the unit box at x, without the nearest image -1 / |x|
+    void ewald_correction(const Eigen::Vector3d &x, Eigen::Vector3d &force, double &potential)
+    {
+        force = Eigen::Vector3d::Zero();
+        potential = M_PI / (alpha * alpha);
+
+        for (int i = -real_images; i <= real_images; i++)
+        {
+            for (int j = -real_images; j <= real_images; j++)
+            {
+                for (int k = -real_images; k <= real_images; k++)
+                {
+                    Eigen::Vector3d d = x - Eigen::Vector3d(i, j, k);
+                    double r = d.norm();
+                    double gauss = 2 * alpha / std::sqrt(M_PI) * std::exp(-alpha * alpha * r * r);
+
+                    if (i == 0 && j == 0 && k == 0)
+                    {
+                        // the nearest image cancels with the newtonian term, erf(alpha r) / r is left
+                        if (r == 0.0)
+                        {
+                            potential += 2 * alpha / std::sqrt(M_PI);
+                            continue;
+                        }
+                        potential += std::erf(alpha * r) / r;
+                        force += d * ((std::erf(alpha * r) - r * gauss) / (r * r * r));
+                        continue;
+                    }
+                    potential += -std::erfc(alpha * r) / r;
+                    force += -d * ((std::erfc(alpha * r) + r * gauss) / (r * r * r));
+                }
+            }
+        }
+
+        for (int i = -reciprocal_vectors; i <= reciprocal_vectors; i++)
+        {
+            for (int j = -reciprocal_vectors; j <= reciprocal_vectors; j++)
+            {
+                for (int k = -reciprocal_vectors; k <= reciprocal_vectors; k++)
+                {
+                    int h2 = i * i + j * j + k * k;
+                    if (h2 == 0 || h2 > reciprocal_vectors * reciprocal_vectors)
+                        continue;
+
+                    Eigen::Vector3d h(i, j, k);
+                    double damping = std::exp(-M_PI * M_PI * h2 / (alpha * alpha)) / h2;
+                    double phase = 2 * M_PI * h.dot(x);
+                    potential += -damping / M_PI * std::cos(phase);
+                    force += -2 * damping * std::sin(phase) * h;
+                }
+            }
+        }
+    }
+}
+
+PeriodicBox::PeriodicBox(double box_size, const std::string &cache_file, int n_grid, unsigned int n_threads)
+    : _L(box_size), _n(std::max(n_grid, 2))
+{
+    if (!cache_file.empty() && _load_table(cache_file))
+        return;
+
+    _compute_table(n_threads);
+    if (!cache_file.empty())
+        _save_table(cache_file);
+}
+
+Eigen::Vector3d PeriodicBox::wrap(const Eigen::Vector3d &position) const
+{
+    return position.unaryExpr([this](double x) { return x - _L * std::floor(x / _L + 0.5); });
+}
+
+Eigen::Vector3d PeriodicBox::minimum_image(const Eigen::Vector3d &r) const
+{
+    return wrap(r);
+}
+
+void PeriodicBox::correction(const Eigen::Vector3d &r, Eigen::Vector3d &force, double &potential) const
+{
+    // the table covers one octant of the unit box, the others follow from the symmetry
+    const double scale = 2.0 * _n / _L;
+    long index[3];
+    double f[3];
+    double sign[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double u = std::min(std::abs(r(axis)) * scale, static_cast<double>(_n));
+        index[axis] = std::min(static_cast<long>(u), static_cast<long>(_n - 1));
+        f[axis] = u - index[axis];
+        sign[axis] = r(axis) < 0 ? -1.0 : 1.0;
+    }
+
+    // trilinear interpolation between the 8 surrounding grid points
+    const long n = _n + 1;
+    Eigen::Vector4d value = Eigen::Vector4d::Zero();
+    for (int a = 0; a < 2; a++)
+    {
+        for (int b = 0; b < 2; b++)
+        {
+            for (int c = 0; c < 2; c++)
+            {
+                double w = (a ? f[0] : 1 - f[0]) * (b ? f[1] : 1 - f[1]) * (c ? f[2] : 1 - f[2]);
+                long i = ((index[0] + a) * n + index[1] + b) * n + index[2] + c;
+                value += w * _table[i];
+            }
+        }
+    }
+
+    // back from the unit box to a box of size L
+    force = value.head<3>().cwiseProduct(Eigen::Vector3d(sign[0], sign[1], sign[2])) / (_L * _L);
+    potential = value(3) / _L;
+}
+
+void PeriodicBox::_compute_table(unsigned int n_threads)
+{
+    const std::size_t n = _n + 1;
+    _table.resize(n * n * n);
+
+    parallel_for(n * n * n, [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            Eigen::Vector3d x(i / (n * n), (i / n) % n, i % n);
+            Eigen::Vector3d force;
+            double potential;
+            ewald_correction(x * (0.5 / _n), force, potential);
+            _table[i] << force, potential;
+        }
+    }, n_threads);
+}
+
+bool PeriodicBox::_load_table(const std::string &filename)
+{
+    std::FILE *file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    // the table is only reused if it was made with the same grid and the same Ewald sums
+    char magic[8];
+    std::int32_t n_grid = 0;
+    double table_alpha = 0.0;
+    std::int32_t images[2] = {0, 0};
+    bool success = std::fread(magic, 1, 8, file) == 8 && std::memcmp(magic, ewald_magic, 8) == 0;
+    success = success && std::fread(&n_grid, sizeof(n_grid), 1, file) == 1 && n_grid == _n;
+    success = success && std::fread(&table_alpha, sizeof(table_alpha), 1, file) == 1 && table_alpha == alpha;
+    success = success && std::fread(images, sizeof(std::int32_t), 2, file) == 2;
+    success = success && images[0] == real_images && images[1] == reciprocal_vectors;
+
+    const std::size_t n = _n + 1;
+    _table.resize(n * n * n);
+    success = success && std::fread(_table.data(), sizeof(Eigen::Vector4d), _table.size(), file) == _table.size();
+    std::fclose(file);
+
+    // a table for another grid or other sums (or a broken file) is simply computed again
+    if (!success)
+        std::cout << "Ewald table in " << filename << " does not fit, computing it again\n";
+    return success;
+}
+
+bool PeriodicBox::_save_table(const std::string &filename) const
+{
+    std::FILE *file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return false;
+    }
+
+    std::int32_t n_grid = _n;
+    double table_alpha = alpha;
+    std::int32_t images[2] = {real_images, reciprocal_vectors};
+    bool success = std::fwrite(ewald_magic, 1, 8, file) == 8;
+    success = success && std::fwrite(&n_grid, sizeof(n_grid), 1, file) == 1;
+    success = success && std::fwrite(&table_alpha, sizeof(table_alpha), 1, file) == 1;
+    success = success && std::fwrite(images, sizeof(std::int32_t), 2, file) == 2;
+    success = success && std::fwrite(_table.data(), sizeof(Eigen::Vector4d), _table.size(), file) == _table.size();
+    success = (std::fclose(file) == 0) && success;
+
+    if (!success)
+        std::cout << "Failed to write Ewald table: " << filename << "\n";
+    return success;
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+#include <math.h>
+#include "Planet.hpp"
+#include "Parallel.hpp"
+#include "RadialProfile.hpp"
+
+RadialProfile::Accumulator &RadialProfile::Accumulator::operator+=(const Accumulator &other)
+{
+    n += other.n;
+    mass += other.mass;
+    v_r += other.v_r;
+    v_r2 += other.v_r2;
+    v_theta += other.v_theta;
+    v_theta2 += other.v_theta2;
+    v_phi += other.v_phi;
+    v_phi2 += other.v_phi2;
+    return *this;
+}
+
+RadialProfile::RadialProfile(double r_min, double r_max, std::size_t n_bins, unsigned int n_threads)
+    : _r_min(r_min), _r_max(r_max), _n_bins(std::max<std::size_t>(n_bins, 1)),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    _log_r_min = std::log(_r_min);
+    _bins_per_log = _n_bins / (std::log(_r_max) - _log_r_min);
+}
+
+const std::vector<ProfileBin> &RadialProfile::compute(std::span<const Planet> planets, double G, double hq_total_mass, double hq_scale_factor)
+{
+    _histograms.assign(_n_threads * _n_bins, Accumulator());
+    _inner_mass.assign(_n_threads, 0.0);
+
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        Accumulator *histogram = _histograms.data() + thread * _n_bins;
+        double inner_mass = 0;
+
+        for (std::size_t i = begin; i < end; i++)
+        {
+            const Planet &planet = planets[i];
+            const Eigen::Vector3d &x = planet.position;
+            const Eigen::Vector3d &v = planet.velocity;
+
+            double r = x.norm();
+            if (r < _r_min)
+            {
+                inner_mass += planet.mass;
+                continue;
+            }
+            if (r >= _r_max)
+                continue;
+
+            std::size_t bin = std::min(static_cast<std::size_t>((std::log(r) - _log_r_min) * _bins_per_log), _n_bins - 1);
+
+            // the velocity in spherical coordinates, on the z axis phi is not defined and we take phi = 0
+            double R = std::sqrt(x.x() * x.x() + x.y() * x.y());
+            double cos_phi = R > 0 ? x.x() / R : 1.0;
+            double sin_phi = R > 0 ? x.y() / R : 0.0;
+            double v_R = v.x() * cos_phi + v.y() * sin_phi;
+
+            double v_r = (R * v_R + x.z() * v.z()) / r;
+            double v_theta = (x.z() * v_R - R * v.z()) / r;
+            double v_phi = v.y() * cos_phi - v.x() * sin_phi;
+
+            Accumulator &a = histogram[bin];
+            a.n++;
+            a.mass += planet.mass;
+            a.v_r += planet.mass * v_r;
+            a.v_r2 += planet.mass * v_r * v_r;
+            a.v_theta += planet.mass * v_theta;
+            a.v_theta2 += planet.mass * v_theta * v_theta;
+            a.v_phi += planet.mass * v_phi;
+            a.v_phi2 += planet.mass * v_phi * v_phi;
+        }
+
+        _inner_mass[thread] = inner_mass;
+    }, _n_threads);
+
+    // add up the histograms of the threads, always in the same order
+    for (unsigned int t = 1; t < _n_threads; t++)
+    {
+        for (std::size_t b = 0; b < _n_bins; b++)
+            _histograms[b] += _histograms[t * _n_bins + b];
+        _inner_mass[0] += _inner_mass[t];
+    }
+
+    auto hq_mass = [&](double r) {
+        return hq_total_mass * r * r / ((r + hq_scale_factor) * (r + hq_scale_factor));
+    };
+
+    _bins.resize(_n_bins);
+    double enclosed_mass = _inner_mass[0];
+    for (std::size_t b = 0; b < _n_bins; b++)
+    {
+        const Accumulator &a = _histograms[b];
+        ProfileBin &bin = _bins[b];
+
+        bin.r_inner = std::exp(_log_r_min + b / _bins_per_log);
+        bin.r_outer = std::exp(_log_r_min + (b + 1) / _bins_per_log);
+        bin.r_center = std::sqrt(bin.r_inner * bin.r_outer);
+        double volume = 4.0 / 3.0 * M_PI * (std::pow(bin.r_outer, 3) - std::pow(bin.r_inner, 3));
+
+        enclosed_mass += a.mass;
+        bin.n_planets = a.n;
+        bin.mass = a.mass;
+        bin.density = a.mass / volume;
+        bin.enclosed_mass = enclosed_mass;
+        bin.circular_velocity = std::sqrt(G * enclosed_mass / bin.r_outer);
+
+        // sigma^2 = <v^2> - <v>^2, which can get slightly negative by rounding
+        auto dispersion = [&a](double sum, double sum2) {
+            double mean = sum / a.mass;
+            return std::sqrt(std::max(0.0, sum2 / a.mass - mean * mean));
+        };
+        if (a.mass > 0)
+        {
+            bin.mean_radial_velocity = a.v_r / a.mass;
+            bin.sigma_r = dispersion(a.v_r, a.v_r2);
+            bin.sigma_theta = dispersion(a.v_theta, a.v_theta2);
+            bin.sigma_phi = dispersion(a.v_phi, a.v_phi2);
+            bin.anisotropy = bin.sigma_r > 0
+                ? 1.0 - (bin.sigma_theta * bin.sigma_theta + bin.sigma_phi * bin.sigma_phi) / (2.0 * bin.sigma_r * bin.sigma_r)
+                : 0.0;
+        }
+        else
+        {
+            bin.mean_radial_velocity = bin.sigma_r = bin.sigma_theta = bin.sigma_phi = bin.anisotropy = 0.0;
+        }
+
+        bin.hq_enclosed_mass = hq_mass(bin.r_outer);
+        bin.hq_density = (bin.hq_enclosed_mass - hq_mass(bin.r_inner)) / volume;
+        bin.hq_circular_velocity = std::sqrt(G * bin.hq_enclosed_mass / bin.r_outer);
+    }
+
+    return _bins;
+}
+
+void RadialProfile::export_to_file(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    file << "r_inner;r_outer;r_center;n;mass;density;enclosed_mass;circular_velocity;"
+         << "mean_v_r;sigma_r;sigma_theta;sigma_phi;anisotropy;"
+         << "hq_density;hq_enclosed_mass;hq_circular_velocity\n";
+    file.precision(10);
+    for (const auto &bin : _bins)
+    {
+        file << bin.r_inner << ";" << bin.r_outer << ";" << bin.r_center << ";"
+             << bin.n_planets << ";" << bin.mass << ";" << bin.density << ";"
+             << bin.enclosed_mass << ";" << bin.circular_velocity << ";"
+             << bin.mean_radial_velocity << ";" << bin.sigma_r << ";" << bin.sigma_theta << ";"
+             << bin.sigma_phi << ";" << bin.anisotropy << ";"
+             << bin.hq_density << ";" << bin.hq_enclosed_mass << ";" << bin.hq_circular_velocity << "\n";
+    }
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "ResultExporter.hpp"
+
+// one csv line has 6 numbers, with at most 17 digits each of them is at most 24 characters long
+static constexpr std::size_t max_line_length = 256;
+
+ResultExporter::ResultExporter(ExportFormat format, int precision, std::size_t buffer_size)
+    : _format(format), _precision(std::min(precision, std::numeric_limits<double>::max_digits10)),
+      _buffer(std::max(buffer_size, 2 * max_line_length))
+{}
+
+std::string ResultExporter::npy_header(std::size_t rows, std::size_t columns, const std::string &type)
+{
+    // see https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+    std::string dictionary = "{'descr': '";
+    dictionary += (std::endian::native == std::endian::little) ? "<" : ">";
+    dictionary += type;
+    dictionary += "', 'fortran_order': False, 'shape': (" + std::to_string(rows) + ", " + std::to_string(columns) + "), }";
+
+    // magic string (6) + version (2) + header length (2) + dictionary has to be a multiple of 64
+    std::size_t length = 10 + dictionary.size() + 1;
+    dictionary.append((64 - length % 64) % 64, ' ');
+    dictionary += '\n';
+
+    std::string header = "\x93NUMPY";
+    header += '\x01';
+    header += '\x00';
+    header += static_cast<char>(dictionary.size() & 0xff);
+    header += static_cast<char>((dictionary.size() >> 8) & 0xff);
+    return header + dictionary;
+}
+
+bool ResultExporter::write_force_computation(std::span<const Eigen::Vector3d> positions, std::span<const Eigen::Vector3d> forces, const std::string & filename)
+{
+    // quickly check that both vectors have the same length
+    if(positions.size() != forces.size())
+    {
+        std::cout << "export for file " << filename << " did not work, as positions and forces have not same dimension";
+        std::cout << "positions has dimension " << positions.size() << ", forces has dimension " << forces.size() << "\n";
+        return false;
+    }
+
+    // plain c file io, the formatting happens in our own buffer anyway
+    std::FILE * file = std::fopen(filename.c_str(), "wb");
+    if(file == nullptr)
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return false;
+    }
+
+    char * buffer = _buffer.data();
+    std::size_t used = 0;
+    bool success = true;
+    auto flush = [&]() {
+        if (used > 0 && std::fwrite(buffer, 1, used, file) != used)
+            success = false;
+        used = 0;
+    };
+
+    if (_format == ExportFormat::npy)
+    {
+        std::string header = npy_header(positions.size(), 6);
+        if (std::fwrite(header.data(), 1, header.size(), file) != header.size())
+            success = false;
+    }
+
+    if (_format == ExportFormat::csv)
+    {
+        char * end = buffer + _buffer.size();
+
+        // formats line i behind the used part of the buffer, nullptr if it does not fit
+        auto format_line = [&](std::size_t i) -> char * {
+            char * current = buffer + used;
+            for (int k = 0; k < 6; k++)
+            {
+                double value = (k < 3) ? positions[i](k) : forces[i](k - 3);
+
+                // the general format with 6 digits is the same as the default of std::ostream
+                auto result = (_precision < 0)
+                    ? std::to_chars(current, end, value)
+                    : std::to_chars(current, end, value, std::chars_format::general, _precision);
+                if (result.ec != std::errc() || result.ptr == end)
+                    return nullptr;
+                current = result.ptr;
+                *current++ = (k < 5) ? ',' : '\n';
+            }
+            return current;
+        };
+
+        for(std::size_t i = 0; i < positions.size() && success; i++)
+        {
+            if (_buffer.size() - used < max_line_length)
+                flush();
+
+            // a line which does not fit gets the whole buffer after a flush
+            char * line_end = format_line(i);
+            if (line_end == nullptr)
+            {
+                flush();
+                line_end = format_line(i);
+            }
+            if (line_end == nullptr)
+            {
+                success = false;
+                break;
+            }
+            used = line_end - buffer;
+        }
+    }
+    else
+    {
+        // the binary formats store one row of 6 doubles per planet
+        const std::size_t row_size = 6 * sizeof(double);
+        for(std::size_t i = 0; i < positions.size(); i++)
+        {
+            if (_buffer.size() - used < row_size)
+                flush();
+
+            std::memcpy(buffer + used, positions[i].data(), 3 * sizeof(double));
+            std::memcpy(buffer + used + 3 * sizeof(double), forces[i].data(), 3 * sizeof(double));
+            used += row_size;
+        }
+    }
+
+    flush();
+    if (std::fclose(file) != 0)
+        success = false;
+
+    if (!success)
+        std::cout << "Failed to write file: " << filename << "\n";
+    return success;
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <vector>
+#include <math.h>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Parallel.hpp"
+#include "SCFSolver.hpp"
+
+SCFSolver::SCFSolver(int n_max, int l_max, double scale_length, double G, unsigned int n_threads)
+    : _n_max(std::max(n_max, 0)), _l_max(std::max(l_max, 0)), _a(scale_length), _G(G),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    _normalisation.assign(_n_coefficients(), 0.0);
+    _A.assign(_n_coefficients(), 0.0);
+    _B.assign(_n_coefficients(), 0.0);
+
+    // the normalisation of the basis functions, Hernquist & Ostriker (1992) eq. 2.30 and 3.15
+    for (int n = 0; n <= _n_max; n++)
+    {
+        for (int l = 0; l <= _l_max; l++)
+        {
+            double K = 0.5 * n * (n + 4 * l + 3) + (l + 1) * (2 * l + 1);
+            double log_I = std::log(K) - (8 * l + 6) * std::log(2.0) + std::lgamma(n + 4 * l + 3.0)
+                         - std::lgamma(n + 1.0) - std::log(n + 2 * l + 1.5) - 2 * std::lgamma(2 * l + 1.5);
+
+            for (int m = 0; m <= l; m++)
+            {
+                double N = (2 * l + 1) / (4 * M_PI) * std::exp(std::lgamma(l - m + 1.0) - std::lgamma(l + m + 1.0));
+
+                // the minus makes A_000 the mass of the hernquist model, as the phi_nl are negative
+                _normalisation[_index(n, l, m)] = -(m == 0 ? 1.0 : 2.0) * N * std::exp(-log_I);
+            }
+        }
+    }
+}
+
+void SCFSolver::_radial_functions(double s, double *phi, double *dphi) const
+{
+    const double xi = (s - 1) / (s + 1);
+    const double dxi_ds = 2 / ((1 + s) * (1 + s));
+
+    double s_l = 1.0;         // s^l
+    double l_s_l_minus_1 = 0; // l s^(l-1), which is 0 for l = 0 also at s = 0
+    double one_plus_s_power = 1 + s; // (1 + s)^(2l+1)
+
+    for (int l = 0; l <= _l_max; l++)
+    {
+        double f = s_l / one_plus_s_power;
+        double df = l_s_l_minus_1 / one_plus_s_power - (2 * l + 1) * f / (1 + s);
+
+        // gegenbauer polynomials C_n^alpha and C_n-1^(alpha+1), the second gives the derivative
+        // dC_n^alpha / dxi = 2 alpha C_n-1^(alpha+1)
+        const double alpha = 2 * l + 1.5;
+        double c_previous = 0, c = 1;         // C_-1, C_0 of alpha
+        double d_previous = 0, d = 0;         // C_-2, C_-1 of alpha + 1
+        for (int n = 0; n <= _n_max; n++)
+        {
+            double dc = 2 * alpha * d;
+            phi[l * (_n_max + 1) + n] = -f * c;
+            dphi[l * (_n_max + 1) + n] = -(df * c + f * dc * dxi_ds);
+
+            // the recurrences (n+1) C_n+1 = 2 (n + alpha) xi C_n - (n + 2 alpha - 1) C_n-1
+            double c_next = (2 * (n + alpha) * xi * c - (n + 2 * alpha - 1) * c_previous) / (n + 1);
+            double d_next = (n == 0) ? 1.0 : (2 * (n - 1 + alpha + 1) * xi * d - (n - 1 + 2 * (alpha + 1) - 1) * d_previous) / n;
+            c_previous = c;
+            c = c_next;
+            d_previous = d;
+            d = d_next;
+        }
+
+        l_s_l_minus_1 = (l + 1) * s_l;
+        s_l *= s;
+        one_plus_s_power *= (1 + s) * (1 + s);
+    }
+}
+
+void SCFSolver::_legendre(double x, double *p, double *dp) const
+{
+    const int L = _l_max + 1;
+    const double sin_theta = std::sqrt(std::max(0.0, 1 - x * x));
+
+    double p_mm = 1.0; // P_m^m = (2m-1)!! sin^m
+    for (int m = 0; m <= _l_max; m++)
+    {
+        p[m * L + m] = p_mm;
+        if (m + 1 <= _l_max)
+            p[(m + 1) * L + m] = x * (2 * m + 1) * p_mm;
+        for (int l = m + 2; l <= _l_max; l++)
+            p[l * L + m] = (x * (2 * l - 1) * p[(l - 1) * L + m] - (l + m - 1) * p[(l - 2) * L + m]) / (l - m);
+
+        // (1 - x^2) dP_l^m / dx = (l + m) P_l-1^m - l x P_l^m
+        for (int l = m; l <= _l_max; l++)
+            dp[l * L + m] = (l > m ? (l + m) * p[(l - 1) * L + m] : 0.0) - l * x * p[l * L + m];
+
+        p_mm *= (2 * m + 1) * sin_theta;
+    }
+}
+
+void SCFSolver::compute_coefficients(std::span<const Planet> planets)
+{
+    const std::size_t n_coefficients = _n_coefficients();
+    const int L = _l_max + 1;
+    const int N = _n_max + 1;
+
+    // every thread sums into its own coefficients
+    std::vector<std::vector<double>> A(_n_threads, std::vector<double>(n_coefficients, 0.0));
+    std::vector<std::vector<double>> B(_n_threads, std::vector<double>(n_coefficients, 0.0));
+
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int thread) {
+        std::vector<double> phi(L * N), dphi(L * N), p(L * L), dp(L * L), cos_m(L), sin_m(L);
+        double *A_thread = A[thread].data();
+        double *B_thread = B[thread].data();
+
+        for (std::size_t k = begin; k < end; k++)
+        {
+            const Eigen::Vector3d &x = planets[k].position;
+            double r = x.norm();
+            double cos_theta = r > 0 ? x.z() / r : 1.0;
+            double phi_angle = std::atan2(x.y(), x.x());
+
+            _radial_functions(r / _a, phi.data(), dphi.data());
+            _legendre(cos_theta, p.data(), dp.data());
+            for (int m = 0; m < L; m++)
+            {
+                cos_m[m] = std::cos(m * phi_angle);
+                sin_m[m] = std::sin(m * phi_angle);
+            }
+
+            const double mass = planets[k].mass;
+            for (int n = 0; n < N; n++)
+            {
+                for (int l = 0; l < L; l++)
+                {
+                    double radial = mass * phi[l * N + n];
+                    for (int m = 0; m <= l; m++)
+                    {
+                        double angular = radial * p[l * L + m];
+                        A_thread[_index(n, l, m)] += angular * cos_m[m];
+                        B_thread[_index(n, l, m)] += angular * sin_m[m];
+                    }
+                }
+            }
+        }
+    }, _n_threads);
+
+    // add up the threads in a fixed order
+    for (std::size_t i = 0; i < n_coefficients; i++)
+    {
+        double a = 0, b = 0;
+        for (unsigned int t = 0; t < _n_threads; t++)
+        {
+            a += A[t][i];
+            b += B[t][i];
+        }
+        _A[i] = _normalisation[i] * a;
+        _B[i] = _normalisation[i] * b;
+    }
+}
+
+void SCFSolver::compute_acceleration_and_potential(const Eigen::Vector3d &position, Eigen::Vector3d &acceleration, double &potential) const
+{
+    const int L = _l_max + 1;
+    const int N = _n_max + 1;
+
+    // small buffers per call, so the function can be used from many threads at once
+    thread_local std::vector<double> phi, dphi, p, dp, cos_m, sin_m;
+    phi.resize(L * N);
+    dphi.resize(L * N);
+    p.resize(L * L);
+    dp.resize(L * L);
+    cos_m.resize(L);
+    sin_m.resize(L);
+
+    double r = position.norm();
+    double R = std::sqrt(position.x() * position.x() + position.y() * position.y());
+    double cos_theta = r > 0 ? position.z() / r : 1.0;
+    double sin_theta = r > 0 ? R / r : 0.0;
+    double phi_angle = std::atan2(position.y(), position.x());
+
+    _radial_functions(r / _a, phi.data(), dphi.data());
+    _legendre(cos_theta, p.data(), dp.data());
+    for (int m = 0; m < L; m++)
+    {
+        cos_m[m] = std::cos(m * phi_angle);
+        sin_m[m] = std::sin(m * phi_angle);
+    }
+
+    // sum of phi, d phi / ds, (1 - x^2) d phi / dx and d phi / d phi_angle in units of G / a
+    double value = 0, d_s = 0, d_x = 0, d_phi = 0;
+    for (int n = 0; n < N; n++)
+    {
+        for (int l = 0; l < L; l++)
+        {
+            double radial = phi[l * N + n];
+            double radial_derivative = dphi[l * N + n];
+            for (int m = 0; m <= l; m++)
+            {
+                std::size_t i = _index(n, l, m);
+                double c = _A[i] * cos_m[m] + _B[i] * sin_m[m];
+                double c_phi = m * (_B[i] * cos_m[m] - _A[i] * sin_m[m]);
+
+                value += radial * p[l * L + m] * c;
+                d_s += radial_derivative * p[l * L + m] * c;
+                d_x += radial * dp[l * L + m] * c;
+                d_phi += radial * p[l * L + m] * c_phi;
+            }
+        }
+    }
+
+    potential += _G / _a * value;
+    if (r == 0.0)
+        return;
+
+    // a = - grad phi in spherical coordinates, d/dtheta = - sin(theta) d/dx
+    // on the z axis the angular parts vanish, so the tiny sine only avoids 0 / 0
+    double safe_sin = std::max(sin_theta, 1e-300);
+    double a_r = -_G / (_a * _a) * d_s;
+    double a_theta = _G / (_a * r) * d_x / safe_sin;
+    double a_phi = -_G / (_a * r) * d_phi / safe_sin;
+
+    double cos_phi = R > 0 ? position.x() / R : 1.0;
+    double sin_phi = R > 0 ? position.y() / R : 0.0;
+    Eigen::Vector3d e_r = position / r;
+    Eigen::Vector3d e_theta(cos_theta * cos_phi, cos_theta * sin_phi, -sin_theta);
+    Eigen::Vector3d e_phi(-sin_phi, cos_phi, 0);
+
+    acceleration += a_r * e_r + a_theta * e_theta + a_phi * e_phi;
+}
+
+std::vector<Eigen::Vector3d> SCFSolver::compute_accelerations(const std::vector<Planet> &planets)
+{
+    compute_coefficients(planets);
+
+    std::vector<Eigen::Vector3d> accelerations(planets.size());
+    _potentials.resize(planets.size());
+    parallel_for(planets.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            accelerations[i] = Eigen::Vector3d::Zero();
+            _potentials[i] = 0.0;
+            compute_acceleration_and_potential(planets[i].position, accelerations[i], _potentials[i]);
+        }
+    }, _n_threads);
+    return accelerations;
+}
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <vector>
+#include <math.h>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "NeighbourSearch.hpp"
+#include "Parallel.hpp"
+#include "SPH.hpp"
+
+namespace
+{
+    // the cubic spline of Monaghan & Lattanzio (1985) with q = r / h, it is zero from q = 2
+    double spline(double q)
+    {
+        if (q < 1.0)
+            return 1.0 - 1.5 * q * q + 0.75 * q * q * q;
+        if (q < 2.0)
+            return 0.25 * (2.0 - q) * (2.0 - q) * (2.0 - q);
+        return 0.0;
+    }
+
+    double spline_derivative(double q)
+    {
+        if (q < 1.0)
+            return -3.0 * q + 2.25 * q * q;
+        if (q < 2.0)
+            return -0.75 * (2.0 - q) * (2.0 - q);
+        return 0.0;
+    }
+
+    // W = w(q) / (pi h^3), its derivatives with respect to r and h
+    void kernel(double r, double h, double &w, double &dw_dh)
+    {
+        double q = r / h;
+        double norm = 1.0 / (M_PI * h * h * h);
+        w = norm * spline(q);
+        dw_dh = -norm / h * (3.0 * spline(q) + q * spline_derivative(q));
+    }
+
+    // dW/dr / r, so the gradient is this times the separation vector
+    double kernel_gradient(double r, double h)
+    {
+        if (r >= 2.0 * h || r == 0.0)
+            return 0.0;
+        return spline_derivative(r / h) / (M_PI * h * h * h * h * r);
+    }
+}
+
+void GasParticles::resize(std::size_t n)
+{
+    for (auto *values : {&x, &y, &z, &vx, &vy, &vz, &mass, &u, &h, &density, &pressure, &sound_speed, &omega, &ax, &ay, &az, &du_dt, &potential})
+        values->resize(n, 0.0);
+}
+
+std::vector<Planet> GasParticles::planets() const
+{
+    std::vector<Planet> planets;
+    planets.reserve(size());
+    for (std::size_t i = 0; i < size(); i++)
+        planets.emplace_back(mass[i], potential[i], position(i), Eigen::Vector3d(vx[i], vy[i], vz[i]));
+    return planets;
+}
+
+GasParticles GasParticles::from_planets(const std::vector<Planet> &planets, double u)
+{
+    GasParticles gas;
+    gas.resize(planets.size());
+    for (std::size_t i = 0; i < planets.size(); i++)
+    {
+        gas.x[i] = planets[i].position(0);
+        gas.y[i] = planets[i].position(1);
+        gas.z[i] = planets[i].position(2);
+        gas.vx[i] = planets[i].velocity(0);
+        gas.vy[i] = planets[i].velocity(1);
+        gas.vz[i] = planets[i].velocity(2);
+        gas.mass[i] = planets[i].mass;
+        gas.u[i] = u;
+    }
+    return gas;
+}
+
+SPHSolver::SPHSolver(const SPHSettings &settings, unsigned int n_threads)
+    : _settings(settings), _n_threads(n_threads != 0 ? n_threads : default_thread_count()),
+      _eta(std::cbrt(3.0 * settings.n_neighbours / (32.0 * M_PI)))
+{}
+
+bool SPHSolver::_solve_smoothing_length(GasParticles &gas, std::size_t i, std::span<const Neighbour> candidates, double radius) const
+{
+    // newton iterations for f(h) = m (eta / h)^3 - rho(h) = 0. f > 0 means h is too small, so every
+    // iteration narrows the interval [h_low, h_high] which contains the root. If newton would leave it
+    // (which happens where f is not monotonic) the interval is bisected instead
+    double h = gas.h[i];
+    double h_low = 0.0;
+    double h_high = std::numeric_limits<double>::infinity();
+    for (int iteration = 0; iteration < _settings.max_iterations; iteration++)
+    {
+        double rho = 0.0;
+        double drho_dh = 0.0;
+        for (const auto &neighbour : candidates)
+        {
+            double w, dw_dh;
+            kernel(std::sqrt(neighbour.distance2), h, w, dw_dh);
+            rho += gas.mass[neighbour.index] * w;
+            drho_dh += gas.mass[neighbour.index] * dw_dh;
+        }
+
+        double rho_h = gas.mass[i] * std::pow(_eta / h, 3);
+        double f = rho_h - rho;
+        double df = -3.0 * rho_h / h - drho_dh;
+        if (f > 0)
+            h_low = h;
+        else
+            h_high = h;
+
+        double h_new = h - f / df;
+        if (!(df < 0 && h_new > h_low && h_new < h_high))
+            h_new = std::isinf(h_high) ? 2.0 * h : 0.5 * (h_low + h_high);
+
+        bool converged = std::abs(h_new - h) < _settings.tolerance * h;
+        h = h_new;
+        if (2 * h > radius)
+        {
+            // some neighbours are missing, the caller searches again with a larger radius
+            gas.h[i] = h;
+            return false;
+        }
+        if (converged)
+            break;
+    }
+
+    // density and its derivative with the final smoothing length
+    double rho = 0.0;
+    double drho_dh = 0.0;
+    for (const auto &neighbour : candidates)
+    {
+        double w, dw_dh;
+        kernel(std::sqrt(neighbour.distance2), h, w, dw_dh);
+        rho += gas.mass[neighbour.index] * w;
+        drho_dh += gas.mass[neighbour.index] * dw_dh;
+    }
+
+    gas.h[i] = h;
+    gas.density[i] = rho;
+    gas.omega[i] = 1.0 + h / (3.0 * rho) * drho_dh;
+    gas.pressure[i] = (_settings.gamma - 1.0) * rho * gas.u[i];
+    gas.sound_speed[i] = std::sqrt(_settings.gamma * gas.pressure[i] / rho);
+    return true;
+}
+
+void SPHSolver::compute_density(GasParticles &gas, const Node &tree) const
+{
+    NeighbourSearch search(tree, _n_threads);
+    const std::size_t n = gas.size();
+
+    // without smoothing lengths from the last step, 2 h starts at the distance of the n_neighbours-th neighbour
+    if (std::any_of(gas.h.begin(), gas.h.end(), [](double h) { return h <= 0.0; }))
+    {
+        auto distances = search.kth_neighbour_distances(static_cast<std::size_t>(std::ceil(_settings.n_neighbours)));
+        for (std::size_t i = 0; i < n; i++)
+            if (gas.h[i] <= 0.0)
+                gas.h[i] = std::max(distances[i], std::numeric_limits<double>::min()) / 2;
+    }
+
+    // the search leaves some room for h to grow, the few particles which need more are searched again
+    const double margin = 1.2;
+    std::vector<double> radii(n);
+    for (std::size_t i = 0; i < n; i++)
+        radii[i] = 2 * gas.h[i] * margin;
+
+    search.for_each_within(radii, [&](std::size_t i, std::span<const Neighbour> neighbours, unsigned int) {
+        double radius = radii[i];
+        if (_solve_smoothing_length(gas, i, neighbours, radius))
+            return;
+        while (true)
+        {
+            radius = 2 * gas.h[i] * margin;
+            auto candidates = search.within(gas.position(i), radius);
+            if (_solve_smoothing_length(gas, i, candidates, radius))
+                return;
+        }
+    });
+}
+
+void SPHSolver::compute_forces(GasParticles &gas, const Node &tree, bool gravity) const
+{
+    const std::size_t n = gas.size();
+    const double alpha = _settings.alpha;
+    const double beta = _settings.beta;
+
+    // the pressure terms P / (omega rho^2) are the same for all pairs of a particle
+    std::vector<double> pressure_term(n);
+    for (std::size_t i = 0; i < n; i++)
+        pressure_term[i] = gas.pressure[i] / (gas.omega[i] * gas.density[i] * gas.density[i]);
+
+    // every pair is computed once and added to both particles, so every thread needs its own sums
+    struct Sums
+    {
+        std::vector<double> ax, ay, az, du_dt;
+    };
+    std::vector<Sums> sums(_n_threads);
+
+    // i found j inside of its kernel. If i is also inside of the kernel of j, j finds i as well,
+    // then only the one with the smaller index computes the pair
+    auto add_pairs = [&](std::size_t i, std::span<const Neighbour> neighbours, Sums &sum) {
+        const double h_i = gas.h[i];
+        for (const auto &neighbour : neighbours)
+        {
+            std::size_t j = neighbour.index;
+            double r2 = neighbour.distance2;
+            if (j == i || r2 == 0.0)
+                continue;
+            const double h_j = gas.h[j];
+            if (r2 < 4 * h_j * h_j && j < i)
+                continue;
+
+            const double r = std::sqrt(r2);
+            const double dx = gas.x[i] - gas.x[j];
+            const double dy = gas.y[i] - gas.y[j];
+            const double dz = gas.z[i] - gas.z[j];
+            const double v_dot_r = (gas.vx[i] - gas.vx[j]) * dx + (gas.vy[i] - gas.vy[j]) * dy + (gas.vz[i] - gas.vz[j]) * dz;
+
+            const double gradient_i = kernel_gradient(r, h_i);
+            const double gradient_j = kernel_gradient(r, h_j);
+            const double gradient_mean = 0.5 * (gradient_i + gradient_j);
+
+            // the artificial viscosity only acts on approaching particles
+            double viscosity = 0.0;
+            if (v_dot_r < 0)
+            {
+                double h_mean = 0.5 * (h_i + h_j);
+                double mu = h_mean * v_dot_r / (r2 + 0.01 * h_mean * h_mean);
+                double c_mean = 0.5 * (gas.sound_speed[i] + gas.sound_speed[j]);
+                double rho_mean = 0.5 * (gas.density[i] + gas.density[j]);
+                viscosity = (-alpha * c_mean * mu + beta * mu * mu) / rho_mean;
+            }
+
+            const double force = pressure_term[i] * gradient_i + pressure_term[j] * gradient_j + viscosity * gradient_mean;
+            sum.ax[i] -= gas.mass[j] * force * dx;
+            sum.ay[i] -= gas.mass[j] * force * dy;
+            sum.az[i] -= gas.mass[j] * force * dz;
+            sum.ax[j] += gas.mass[i] * force * dx;
+            sum.ay[j] += gas.mass[i] * force * dy;
+            sum.az[j] += gas.mass[i] * force * dz;
+
+            sum.du_dt[i] += gas.mass[j] * (pressure_term[i] * gradient_i + 0.5 * viscosity * gradient_mean) * v_dot_r;
+            sum.du_dt[j] += gas.mass[i] * (pressure_term[j] * gradient_j + 0.5 * viscosity * gradient_mean) * v_dot_r;
+        }
+    };
+
+    auto prepare = [&](unsigned int thread) {
+        for (auto *values : {&sums[thread].ax, &sums[thread].ay, &sums[thread].az, &sums[thread].du_dt})
+            values->assign(n, 0.0);
+    };
+
+    std::vector<double> radii(n);
+    for (std::size_t i = 0; i < n; i++)
+        radii[i] = 2 * gas.h[i];
+
+    std::fill(gas.potential.begin(), gas.potential.end(), 0.0);
+    std::vector<Eigen::Vector3d> gravity_acceleration(gravity ? n : 0, Eigen::Vector3d::Zero());
+    if (gravity)
+    {
+        // one walk gives the gravity and the neighbours of a particle
+        parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned int thread) {
+            prepare(thread);
+            std::vector<Neighbour> neighbours;
+            for (std::size_t i = begin; i < end; i++)
+            {
+                neighbours.clear();
+                Planet planet(gas.mass[i], 0.0, gas.position(i), Eigen::Vector3d::Zero());
+                tree.compute_acceleration_and_neighbours(planet, radii[i], gravity_acceleration[i], gas.potential[i], neighbours);
+                add_pairs(i, neighbours, sums[thread]);
+            }
+        }, _n_threads);
+    }
+    else
+    {
+        NeighbourSearch search(tree, _n_threads);
+        for (unsigned int thread = 0; thread < _n_threads; thread++)
+            prepare(thread);
+        search.for_each_within(radii, [&](std::size_t i, std::span<const Neighbour> neighbours, unsigned int thread) {
+            add_pairs(i, neighbours, sums[thread]);
+        });
+    }
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+        gas.ax[i] = gravity ? gravity_acceleration[i](0) : 0.0;
+        gas.ay[i] = gravity ? gravity_acceleration[i](1) : 0.0;
+        gas.az[i] = gravity ? gravity_acceleration[i](2) : 0.0;
+        gas.du_dt[i] = 0.0;
+    }
+    for (const auto &sum : sums)
+    {
+        if (sum.ax.empty())
+            continue;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            gas.ax[i] += sum.ax[i];
+            gas.ay[i] += sum.ay[i];
+            gas.az[i] += sum.az[i];
+            gas.du_dt[i] += sum.du_dt[i];
+        }
+    }
+}
+
+double SPHSolver::timestep(const GasParticles &gas) const
+{
+    double dt = std::numeric_limits<double>::infinity();
+    for (std::size_t i = 0; i < gas.size(); i++)
+    {
+        // the signal speed includes the viscosity, which can be much faster than sound in shocks
+        double signal = gas.sound_speed[i] * (1.0 + 1.2 * _settings.alpha);
+        if (signal > 0)
+            dt = std::min(dt, _settings.courant * gas.h[i] / signal);
+
+        double a = std::sqrt(gas.ax[i] * gas.ax[i] + gas.ay[i] * gas.ay[i] + gas.az[i] * gas.az[i]);
+        if (a > 0)
+            dt = std::min(dt, _settings.courant * std::sqrt(gas.h[i] / a));
+    }
+    return dt;
+}
@@ -0,0 +1,331 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+#include "SnapshotArchive.hpp"
+
+namespace
+{
+    const char header_magic[8] = {'N', 'B', 'S', 'N', 'A', 'P', '0', '1'};
+    const char footer_magic[8] = {'N', 'B', 'S', 'N', 'A', 'P', 'I', 'X'};
+
+    // magic + number of particles + number of fields + keyframe interval
+    const std::uint64_t header_size = 32;
+
+    // index offset + number of frames + magic
+    const std::uint64_t footer_size = 24;
+
+    /*
+    The two predictions for value i of a column
+    A keyframe can only use the values before i in the same column,
+    the other snapshots use the same value in the last one or two snapshots
+    */
+    inline void predict(bool keyframe, bool has_previous2, const double *column, const double *previous, const double *previous2, std::size_t i, double &p0, double &p1)
+    {
+        if (keyframe)
+        {
+            p0 = i > 0 ? column[i - 1] : 0.0;
+            p1 = i > 1 ? 2.0 * column[i - 1] - column[i - 2] : p0;
+        }
+        else
+        {
+            p0 = previous[i];
+            p1 = has_previous2 ? 2.0 * previous[i] - previous2[i] : p0;
+        }
+    }
+
+    // the number of leading zero bytes (0 to 8) is stored in 3 bits
+    // 4 leading zero bytes are rare, so they are stored as 3 (and one zero byte more is written)
+    inline unsigned code_of(unsigned leading_zero_bytes)
+    {
+        if (leading_zero_bytes == 4)
+            leading_zero_bytes = 3;
+        return leading_zero_bytes > 4 ? leading_zero_bytes - 1 : leading_zero_bytes;
+    }
+
+    inline unsigned leading_zero_bytes_of(unsigned code)
+    {
+        return code >= 4 ? code + 1 : code;
+    }
+
+    template <typename T>
+    void write_value(std::ofstream &file, T value)
+    {
+        file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    T read_value(std::ifstream &file)
+    {
+        T value{};
+        file.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return value;
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &filename, std::size_t n_particles, std::size_t n_fields, std::size_t keyframe_interval)
+    : _file(filename, std::ios::binary), _n_particles(n_particles), _n_fields(n_fields),
+      _keyframe_interval(keyframe_interval > 0 ? keyframe_interval : 1)
+{
+    if (!_file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    std::size_t n_values = 3 * _n_fields * _n_particles;
+    _current.resize(n_values);
+    _previous.resize(n_values);
+    _previous2.resize(n_values);
+    _residuals.reserve(8 * n_values);
+
+    _file.write(header_magic, 8);
+    write_value<std::uint64_t>(_file, _n_particles);
+    write_value<std::uint64_t>(_file, _n_fields);
+    write_value<std::uint64_t>(_file, _keyframe_interval);
+    _offset = header_size;
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    close();
+}
+
+bool SnapshotWriter::append(double time, std::initializer_list<std::span<const Eigen::Vector3d>> fields)
+{
+    if (!_file.is_open() || fields.size() != _n_fields)
+        return false;
+    for (const auto &field : fields)
+        if (field.size() != _n_particles)
+            return false;
+
+    // bring the vectors into column order, so each column holds similar values
+    const std::size_t n = _n_particles;
+    std::size_t f = 0;
+    for (const auto &field : fields)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            double *column = _current.data() + (3 * f + axis) * n;
+            for (std::size_t i = 0; i < n; i++)
+                column[i] = field[i](axis);
+        }
+        f++;
+    }
+
+    const std::size_t frame = _index.size();
+    const bool keyframe = frame % _keyframe_interval == 0;
+    const bool has_previous2 = frame % _keyframe_interval >= 2;
+
+    const std::size_t n_values = _current.size();
+    _codes.assign((n_values + 1) / 2, 0);
+    _residuals.clear();
+
+    for (std::size_t c = 0; c < 3 * _n_fields; c++)
+    {
+        const double *column = _current.data() + c * n;
+        const double *previous = _previous.data() + c * n;
+        const double *previous2 = _previous2.data() + c * n;
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double p0, p1;
+            predict(keyframe, has_previous2, column, previous, previous2, i, p0, p1);
+
+            // take the prediction which shares more leading bits with the value
+            std::uint64_t bits = std::bit_cast<std::uint64_t>(column[i]);
+            std::uint64_t x0 = bits ^ std::bit_cast<std::uint64_t>(p0);
+            std::uint64_t x1 = bits ^ std::bit_cast<std::uint64_t>(p1);
+            unsigned selector = x1 < x0 ? 1 : 0;
+            std::uint64_t x = selector ? x1 : x0;
+
+            unsigned code = code_of(std::countl_zero(x) / 8);
+            unsigned stored_bytes = 8 - leading_zero_bytes_of(code);
+
+            std::size_t index = c * n + i;
+            _codes[index / 2] |= static_cast<std::uint8_t>(((selector << 3) | code) << (4 * (index & 1)));
+            for (unsigned b = 0; b < stored_bytes; b++)
+                _residuals.push_back(static_cast<std::uint8_t>(x >> (8 * b)));
+        }
+    }
+
+    std::uint64_t size = 16 + _codes.size() + _residuals.size();
+    write_value<std::uint64_t>(_file, _codes.size());
+    write_value<std::uint64_t>(_file, _residuals.size());
+    _file.write(reinterpret_cast<const char *>(_codes.data()), _codes.size());
+    _file.write(reinterpret_cast<const char *>(_residuals.data()), _residuals.size());
+
+    _index.push_back(IndexEntry{_offset, size, time});
+    _offset += size;
+
+    // the current snapshot is the prediction for the next one
+    std::swap(_previous2, _previous);
+    std::swap(_previous, _current);
+
+    return _file.good();
+}
+
+void SnapshotWriter::close()
+{
+    if (!_file.is_open())
+        return;
+
+    std::uint64_t index_offset = _offset;
+    for (const auto &entry : _index)
+    {
+        write_value<std::uint64_t>(_file, entry.offset);
+        write_value<std::uint64_t>(_file, entry.size);
+        write_value<double>(_file, entry.time);
+    }
+    write_value<std::uint64_t>(_file, index_offset);
+    write_value<std::uint64_t>(_file, _index.size());
+    _file.write(footer_magic, 8);
+    _offset += 24 * _index.size() + footer_size;
+
+    _file.close();
+}
+
+SnapshotReader::SnapshotReader(const std::string &filename)
+    : _file(filename, std::ios::binary)
+{
+    if (!_file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+
+    char magic[8];
+    _file.read(magic, 8);
+    _n_particles = read_value<std::uint64_t>(_file);
+    _n_fields = read_value<std::uint64_t>(_file);
+    _keyframe_interval = read_value<std::uint64_t>(_file);
+    if (!_file.good() || std::memcmp(magic, header_magic, 8) != 0 || _keyframe_interval == 0)
+    {
+        std::cout << "Not a snapshot archive: " << filename << "\n";
+        _file.close();
+        return;
+    }
+
+    // the footer tells us where the index is
+    _file.seekg(-static_cast<std::streamoff>(footer_size), std::ios::end);
+    std::uint64_t index_offset = read_value<std::uint64_t>(_file);
+    std::uint64_t n_frames = read_value<std::uint64_t>(_file);
+    _file.read(magic, 8);
+    if (!_file.good() || std::memcmp(magic, footer_magic, 8) != 0)
+    {
+        std::cout << "Snapshot archive without index (was it closed?): " << filename << "\n";
+        _file.close();
+        return;
+    }
+
+    _file.seekg(static_cast<std::streamoff>(index_offset));
+    _index.resize(n_frames);
+    for (auto &entry : _index)
+    {
+        entry.offset = read_value<std::uint64_t>(_file);
+        entry.size = read_value<std::uint64_t>(_file);
+        entry.time = read_value<double>(_file);
+    }
+
+    std::size_t n_values = 3 * _n_fields * _n_particles;
+    _current.resize(n_values);
+    _previous.resize(n_values);
+    _previous2.resize(n_values);
+}
+
+bool SnapshotReader::_decode(std::size_t frame)
+{
+    const auto &entry = _index[frame];
+    _encoded.resize(entry.size);
+    _file.seekg(static_cast<std::streamoff>(entry.offset));
+    _file.read(reinterpret_cast<char *>(_encoded.data()), entry.size);
+    if (!_file.good())
+        return false;
+
+    std::uint64_t codes_size, residuals_size;
+    std::memcpy(&codes_size, _encoded.data(), 8);
+    std::memcpy(&residuals_size, _encoded.data() + 8, 8);
+    if (16 + codes_size + residuals_size != entry.size)
+        return false;
+
+    const std::uint8_t *codes = _encoded.data() + 16;
+    const std::uint8_t *residual = codes + codes_size;
+    const std::uint8_t *residual_end = residual + residuals_size;
+
+    const std::size_t n = _n_particles;
+    const bool keyframe = frame % _keyframe_interval == 0;
+    const bool has_previous2 = frame % _keyframe_interval >= 2;
+
+    for (std::size_t c = 0; c < 3 * _n_fields; c++)
+    {
+        double *column = _current.data() + c * n;
+        const double *previous = _previous.data() + c * n;
+        const double *previous2 = _previous2.data() + c * n;
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            std::size_t index = c * n + i;
+            unsigned nibble = (codes[index / 2] >> (4 * (index & 1))) & 0xf;
+            unsigned selector = nibble >> 3;
+            unsigned stored_bytes = 8 - leading_zero_bytes_of(nibble & 0x7);
+
+            if (residual + stored_bytes > residual_end)
+                return false;
+
+            std::uint64_t x = 0;
+            for (unsigned b = 0; b < stored_bytes; b++)
+                x |= static_cast<std::uint64_t>(*residual++) << (8 * b);
+
+            double p0, p1;
+            predict(keyframe, has_previous2, column, previous, previous2, i, p0, p1);
+            column[i] = std::bit_cast<double>(std::bit_cast<std::uint64_t>(selector ? p1 : p0) ^ x);
+        }
+    }
+
+    std::swap(_previous2, _previous);
+    std::swap(_previous, _current);
+    _decoded_frame = frame;
+    return true;
+}
+
+bool SnapshotReader::read(std::size_t frame, std::vector<std::vector<Eigen::Vector3d>> &fields)
+{
+    if (!_file.is_open() || frame >= _index.size())
+        return false;
+
+    if (_decoded_frame != frame)
+    {
+        // continue from the last decoded snapshot if it lies between the keyframe and the wanted one
+        std::size_t start = frame - frame % _keyframe_interval;
+        if (_decoded_frame != SIZE_MAX && _decoded_frame >= start && _decoded_frame < frame)
+            start = _decoded_frame + 1;
+
+        for (std::size_t f = start; f <= frame; f++)
+        {
+            if (!_decode(f))
+            {
+                _decoded_frame = SIZE_MAX;
+                std::cout << "Snapshot " << f << " is corrupted\n";
+                return false;
+            }
+        }
+    }
+
+    // the last decoded snapshot is in _previous
+    const std::size_t n = _n_particles;
+    fields.resize(_n_fields);
+    for (std::size_t f = 0; f < _n_fields; f++)
+    {
+        fields[f].resize(n);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const double *column = _previous.data() + (3 * f + axis) * n;
+            for (std::size_t i = 0; i < n; i++)
+                fields[f][i](axis) = column[i];
+        }
+    }
+    return true;
+}
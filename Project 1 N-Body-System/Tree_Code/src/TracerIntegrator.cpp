@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "SCFSolver.hpp"
+#include "Parallel.hpp"
+#include "NBodyIntegrator.hpp"
+#include "FieldProbe.hpp"
+#include "TracerIntegrator.hpp"
+
+void Tracers::resize(std::size_t n)
+{
+    for (auto *array : {&x, &y, &z, &vx, &vy, &vz})
+        array->resize(n, 0.0);
+}
+
+Tracers Tracers::from_planets(const std::vector<Planet> &planets)
+{
+    Tracers tracers;
+    tracers.resize(planets.size());
+    for (std::size_t i = 0; i < planets.size(); i++)
+    {
+        tracers.x[i] = planets[i].position(0);
+        tracers.y[i] = planets[i].position(1);
+        tracers.z[i] = planets[i].position(2);
+        tracers.vx[i] = planets[i].velocity(0);
+        tracers.vy[i] = planets[i].velocity(1);
+        tracers.vz[i] = planets[i].velocity(2);
+    }
+    return tracers;
+}
+
+TracerIntegrator::TracerIntegrator(BlockAcceleration acceleration, IntegrationScheme scheme, std::size_t block_size,
+                                   bool spatial_blocks, unsigned int n_threads)
+    : _acceleration(std::move(acceleration)), _block_size(std::max<std::size_t>(block_size, 1)), _spatial_blocks(spatial_blocks),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{
+    NBodyIntegrator::scheme_weights(scheme, _kicks, _drifts);
+}
+
+TracerIntegrator::BlockAcceleration TracerIntegrator::hernquist(double mass, double scale_length, double G)
+{
+    return [mass, scale_length, G](std::size_t n, const double *x, const double *y, const double *z, double *ax, double *ay, double *az) {
+        // a = - G M(<r) / r^2 x / r = - G M x / (r (r + a)^2), which is 0 at the center
+        // four tracers at a time in an Eigen::Array4d: a plain loop is not vectorized by gcc, as std::sqrt
+        // may set errno and std::max is a branch, while Eigen does the sqrt and the max with SIMD instructions
+        using Eigen::Array4d;
+        const double GM = G * mass;
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            Array4d px = Array4d::Map(x + i);
+            Array4d py = Array4d::Map(y + i);
+            Array4d pz = Array4d::Map(z + i);
+            Array4d r = (px * px + py * py + pz * pz).sqrt();
+            Array4d s = r + scale_length;
+            Array4d factor = -GM / (r.max(1e-300) * s * s);
+            Array4d::Map(ax + i) = factor * px;
+            Array4d::Map(ay + i) = factor * py;
+            Array4d::Map(az + i) = factor * pz;
+        }
+        for (; i < n; i++)
+        {
+            double r = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+            double s = r + scale_length;
+            double factor = -GM / (std::max(r, 1e-300) * s * s);
+            ax[i] = factor * x[i];
+            ay[i] = factor * y[i];
+            az[i] = factor * z[i];
+        }
+    };
+}
+
+TracerIntegrator::BlockAcceleration TracerIntegrator::frozen_tree(const Node &tree)
+{
+    return [&tree](std::size_t n, const double *x, const double *y, const double *z, double *ax, double *ay, double *az) {
+        std::vector<Eigen::Vector3d> points(n);
+        for (std::size_t i = 0; i < n; i++)
+            points[i] = Eigen::Vector3d(x[i], y[i], z[i]);
+        Eigen::Vector3d lower = points[0];
+        Eigen::Vector3d upper = points[0];
+        for (const auto &point : points)
+        {
+            lower = lower.cwiseMin(point);
+            upper = upper.cwiseMax(point);
+        }
+
+        std::vector<Eigen::Vector3d> accelerations(n, Eigen::Vector3d::Zero());
+        std::vector<double> potentials(n, 0.0);
+        tree.compute_field(points, lower, upper, accelerations, potentials);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            ax[i] = accelerations[i](0);
+            ay[i] = accelerations[i](1);
+            az[i] = accelerations[i](2);
+        }
+    };
+}
+
+TracerIntegrator::BlockAcceleration TracerIntegrator::frozen_scf(const SCFSolver &scf)
+{
+    return [&scf](std::size_t n, const double *x, const double *y, const double *z, double *ax, double *ay, double *az) {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+            double potential = 0.0;
+            scf.compute_acceleration_and_potential(Eigen::Vector3d(x[i], y[i], z[i]), acceleration, potential);
+            ax[i] = acceleration(0);
+            ay[i] = acceleration(1);
+            az[i] = acceleration(2);
+        }
+    };
+}
+
+void TracerIntegrator::integrate(Tracers &tracers, double dt, int n_steps)
+{
+    if (tracers.size() == 0)
+        return;
+
+    // the tracers in the order in which they are put into blocks
+    std::vector<std::size_t> order(tracers.size());
+    if (_spatial_blocks)
+    {
+        std::vector<Eigen::Vector3d> positions(tracers.size());
+        for (std::size_t i = 0; i < tracers.size(); i++)
+            positions[i] = tracers.position(i);
+        order = FieldProbe::morton_order(positions);
+    }
+    else
+    {
+        std::iota(order.begin(), order.end(), 0);
+    }
+
+    const std::size_t n_blocks = (tracers.size() + _block_size - 1) / _block_size;
+
+    parallel_for(n_blocks, [&](std::size_t begin, std::size_t end, unsigned int) {
+        std::vector<double> x(_block_size), y(_block_size), z(_block_size);
+        std::vector<double> vx(_block_size), vy(_block_size), vz(_block_size);
+        std::vector<double> ax(_block_size), ay(_block_size), az(_block_size);
+        for (std::size_t b = begin; b < end; b++)
+        {
+            const std::size_t first = b * _block_size;
+            const std::size_t n = std::min(_block_size, tracers.size() - first);
+            for (std::size_t i = 0; i < n; i++)
+            {
+                std::size_t t = order[first + i];
+                x[i] = tracers.x[t];
+                y[i] = tracers.y[t];
+                z[i] = tracers.z[t];
+                vx[i] = tracers.vx[t];
+                vy[i] = tracers.vy[t];
+                vz[i] = tracers.vz[t];
+            }
+
+            // the accelerations after the last kick of a step are the ones the next step starts with
+            bool accelerations_valid = false;
+            auto kick = [&](double h) {
+                if (!accelerations_valid)
+                {
+                    _acceleration(n, x.data(), y.data(), z.data(), ax.data(), ay.data(), az.data());
+                    accelerations_valid = true;
+                }
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    vx[i] += ax[i] * h;
+                    vy[i] += ay[i] * h;
+                    vz[i] += az[i] * h;
+                }
+            };
+            auto drift = [&](double h) {
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    x[i] += vx[i] * h;
+                    y[i] += vy[i] * h;
+                    z[i] += vz[i] * h;
+                }
+                accelerations_valid = false;
+            };
+
+            for (int step = 0; step < n_steps; step++)
+            {
+                for (std::size_t k = 0; k < _drifts.size(); k++)
+                {
+                    if (_kicks[k] != 0.0)
+                        kick(_kicks[k] * dt);
+                    drift(_drifts[k] * dt);
+                }
+                if (_kicks.back() != 0.0)
+                    kick(_kicks.back() * dt);
+            }
+
+            // every tracer is in exactly one block, so the threads write to different places
+            for (std::size_t i = 0; i < n; i++)
+            {
+                std::size_t t = order[first + i];
+                tracers.x[t] = x[i];
+                tracers.y[t] = y[i];
+                tracers.z[t] = z[i];
+                tracers.vx[t] = vx[i];
+                tracers.vy[t] = vy[i];
+                tracers.vz[t] = vz[i];
+            }
+        }
+    }, _n_threads);
+
+    _time += n_steps * dt;
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "Planet.hpp"
+#include "Node.hpp"
+#include "Parallel.hpp"
+#include "TreeTuner.hpp"
+
+namespace
+{
+    // the leaf sizes which are tried, the theta is searched in [0, max_theta]
+    const std::vector<int> tuned_limits = {1, 2, 4, 8, 16, 32, 64};
+    const double max_theta = 1.5;
+    const int bisection_steps = 10;
+    const int n_strata = 10;
+
+    double milliseconds_since(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+TreeTuner::TreeTuner(double target_error, double G, double softening, std::size_t n_samples, unsigned int n_threads)
+    : _target_error(target_error), _G(G), _softening(softening), _n_samples(std::max<std::size_t>(n_samples, 1)),
+      _n_threads(n_threads != 0 ? n_threads : default_thread_count())
+{}
+
+TreeConfiguration TreeTuner::tune(const std::vector<Planet> &planets, const std::string &cache_file)
+{
+    _candidates.clear();
+    if (planets.empty())
+        return TreeConfiguration();
+
+    const std::uint64_t fingerprint = _fingerprint(planets);
+    TreeConfiguration best;
+    if (!cache_file.empty() && _load(cache_file, fingerprint, best))
+        return best;
+
+    const std::vector<std::size_t> samples = _draw_samples(planets);
+    const std::vector<Eigen::Vector3d> exact = _direct(planets, samples);
+    const double scale = static_cast<double>(planets.size()) / samples.size();
+
+    for (int limit : tuned_limits)
+    {
+        // the structure of the tree does not depend on theta and the expansion, so it is built once
+        auto build_start = std::chrono::high_resolution_clock::now();
+        Node tree = Node::build(planets, limit, _G, max_theta, _softening);
+        double build_time = milliseconds_since(build_start);
+
+        for (bool quadrupole : {true, false})
+        {
+            // the error grows with theta, so the largest theta which reaches the target is bisected
+            // theta = 0 opens every node, which is the direct summation
+            double lower = 0.0;
+            double upper = max_theta;
+            tree.set_opening(upper, quadrupole);
+            if (_error(tree, planets, samples, exact) > _target_error)
+            {
+                for (int step = 0; step < bisection_steps; step++)
+                {
+                    double middle = 0.5 * (lower + upper);
+                    tree.set_opening(middle, quadrupole);
+                    if (_error(tree, planets, samples, exact) <= _target_error)
+                        lower = middle;
+                    else
+                        upper = middle;
+                }
+                upper = lower;
+            }
+
+            TreeConfiguration candidate;
+            candidate.theta = upper;
+            candidate.limit = limit;
+            candidate.quadrupole = quadrupole;
+            tree.set_opening(candidate.theta, quadrupole);
+            candidate.error = _error(tree, planets, samples, exact);
+            candidate.build_time = build_time;
+            candidate.walk_time = _walk_time(tree, planets, samples) * scale;
+            _candidates.push_back(candidate);
+        }
+    }
+
+    best = *std::min_element(_candidates.begin(), _candidates.end(), [](const TreeConfiguration &a, const TreeConfiguration &b) {
+        return a.build_time + a.walk_time < b.build_time + b.walk_time;
+    });
+    if (!cache_file.empty())
+        _save(cache_file, fingerprint, best);
+    return best;
+}
+
+std::vector<std::size_t> TreeTuner::_draw_samples(const std::vector<Planet> &planets) const
+{
+    // the planets sorted by their distance to the center of mass, cut into strata with the same number of planets
+    // every stratum gets the same number of samples, so the dense center and the sparse outskirts are both in it
+    Eigen::Vector3d com = Eigen::Vector3d::Zero();
+    double mass = 0.0;
+    for (const auto &planet : planets)
+    {
+        com += planet.mass * planet.position;
+        mass += planet.mass;
+    }
+    com /= mass;
+
+    std::vector<double> radius(planets.size());
+    for (std::size_t i = 0; i < planets.size(); i++)
+        radius[i] = (planets[i].position - com).norm();
+    std::vector<std::size_t> order(planets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&radius](std::size_t a, std::size_t b) { return radius[a] < radius[b]; });
+
+    // a fixed seed, so the same planets always give the same samples
+    const std::size_t n = planets.size();
+    const std::size_t k = std::min(_n_samples, n);
+    std::mt19937 generator(42);
+    std::vector<std::size_t> samples;
+    for (int s = 0; s < n_strata; s++)
+    {
+        std::size_t first = n * s / n_strata;
+        std::size_t last = n * (s + 1) / n_strata;
+        std::size_t count = k * (s + 1) / n_strata - k * s / n_strata;
+        std::sample(order.begin() + first, order.begin() + last, std::back_inserter(samples), count, generator);
+    }
+    return samples;
+}
+
+std::vector<Eigen::Vector3d> TreeTuner::_direct(const std::vector<Planet> &planets, const std::vector<std::size_t> &samples) const
+{
+    // the same kernel as in the leaves, so only the multipoles make the error
+    const double s2 = _softening * _softening;
+    std::vector<Eigen::Vector3d> accelerations(samples.size(), Eigen::Vector3d::Zero());
+    parallel_for(samples.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t k = begin; k < end; k++)
+        {
+            const Planet &p = planets[samples[k]];
+            Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+            for (const auto &other : planets)
+            {
+                Eigen::Vector3d r = p.position - other.position;
+                double r2 = r.squaredNorm();
+                if (r2 == 0.0)
+                    continue;
+                double inverse_r = 1.0 / std::sqrt(r2 + s2);
+                acceleration += -_G * other.mass * r * (inverse_r * inverse_r * inverse_r);
+            }
+            accelerations[k] = acceleration;
+        }
+    }, _n_threads);
+    return accelerations;
+}
+
+double TreeTuner::_error(const Node &tree, const std::vector<Planet> &planets, const std::vector<std::size_t> &samples, const std::vector<Eigen::Vector3d> &exact) const
+{
+    std::vector<double> errors(samples.size(), 0.0);
+    parallel_for(samples.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t k = begin; k < end; k++)
+        {
+            Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+            double potential = 0.0;
+            tree.compute_acceleration_and_potential(planets[samples[k]], acceleration, potential);
+            double norm = exact[k].norm();
+            errors[k] = norm > 0.0 ? (acceleration - exact[k]).norm() / norm : 0.0;
+        }
+    }, _n_threads);
+
+    // not the 99th percentile of the sample itself but the upper end of its 95% confidence interval,
+    // so the target is also reached by all planets and not only by the sample: the number of samples
+    // below the 99th percentile is binomial(n, 0.99), which is below n q + 1.96 sqrt(n q (1 - q)) in 97.5% of the cases
+    const double n = static_cast<double>(errors.size());
+    const double upper_rank = 0.99 * n + 1.96 * std::sqrt(n * 0.99 * 0.01) + 1;
+    std::size_t rank = std::min(errors.size() - 1, static_cast<std::size_t>(std::ceil(upper_rank)) - 1);
+    std::nth_element(errors.begin(), errors.begin() + rank, errors.end());
+    return errors[rank];
+}
+
+double TreeTuner::_walk_time(const Node &tree, const std::vector<Planet> &planets, const std::vector<std::size_t> &samples) const
+{
+    // the same walk as in the ForceSolver, with the potential
+    double fastest = 0.0;
+    for (int repetition = 0; repetition < 3; repetition++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        parallel_for(samples.size(), [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t k = begin; k < end; k++)
+            {
+                Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+                double potential = 0.0;
+                tree.compute_acceleration_and_potential(planets[samples[k]], acceleration, potential);
+            }
+        }, _n_threads);
+        double time = milliseconds_since(start);
+        fastest = repetition == 0 ? time : std::min(fastest, time);
+    }
+    return fastest;
+}
+
+std::uint64_t TreeTuner::_fingerprint(const std::vector<Planet> &planets) const
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void *data, std::size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    std::uint64_t n = planets.size();
+    std::uint64_t n_samples = _n_samples;
+    add(&n, sizeof(n));
+    add(&n_samples, sizeof(n_samples));
+    add(&_G, sizeof(_G));
+    add(&_softening, sizeof(_softening));
+    for (const auto &planet : planets)
+    {
+        add(&planet.mass, sizeof(double));
+        add(planet.position.data(), 3 * sizeof(double));
+    }
+    return hash;
+}
+
+bool TreeTuner::_load(const std::string &filename, std::uint64_t fingerprint, TreeConfiguration &configuration) const
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    // fingerprint hardware_threads n_threads target theta limit quadrupole error build_time walk_time
+    bool found = false;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::uint64_t line_fingerprint;
+        unsigned int hardware_threads, n_threads;
+        double target;
+        TreeConfiguration entry;
+        if (!(stream >> line_fingerprint >> hardware_threads >> n_threads >> target >> entry.theta >> entry.limit >> entry.quadrupole >> entry.error >> entry.build_time >> entry.walk_time))
+            continue;
+
+        // a later line for the same key is a newer result
+        if (line_fingerprint == fingerprint && hardware_threads == default_thread_count() && n_threads == _n_threads && target == _target_error)
+        {
+            configuration = entry;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void TreeTuner::_save(const std::string &filename, std::uint64_t fingerprint, const TreeConfiguration &configuration) const
+{
+    std::ofstream file(filename, std::ios::app);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filename << "\n";
+        return;
+    }
+    file << fingerprint << " " << default_thread_count() << " " << _n_threads << " " << std::setprecision(17) << _target_error << " "
+         << configuration.theta << " " << configuration.limit << " " << configuration.quadrupole << " "
+         << configuration.error << " " << configuration.build_time << " " << configuration.walk_time << "\n";
+}
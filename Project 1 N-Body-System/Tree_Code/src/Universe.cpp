@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <iterator>
 #include <vector>
 #include <Eigen/Dense>
 #include <math.h>
@@ -11,7 +13,7 @@ double Universe::calculate_mean_interparticle_separation() const
     // since all particles have the same size
     // the number of particles which are inside the half mass radius
     // es exactely half of all particles
-    double num_inside = _magnitudes.size() / 2;
+    double num_inside = _planets.size() / 2;
     // 22/7 is used as a quick pi appr
     double half_mass_radius_to_three = _half_mass_radius * _half_mass_radius * _half_mass_radius;
     double half_mass_volume = 4 / 3 * M_PI * half_mass_radius_to_three;
@@ -42,12 +44,37 @@ std::vector<Eigen::Vector3d> Universe::calculate_direct_nbody_forces(double s, d
     return forces;
 }
 
+std::vector<Eigen::Vector3d> Universe::calculate_direct_nbody_forces(double s, double G, const PeriodicBox & box) const
+{
+    std::vector<Eigen::Vector3d> forces(_planets.size(), Eigen::Vector3d(0,0,0));
+    for (std::size_t i = 0; i < _planets.size(); i++)
+    {
+        for (std::size_t j = i + 1; j < _planets.size(); j++)
+        {
+            Eigen::Vector3d r_vec = box.minimum_image(_planets[i].position - _planets[j].position);
+            double r_mag = r_vec.norm();
+
+            // the correction is odd in r, so actio = reactio still holds
+            Eigen::Vector3d correction;
+            double correction_potential;
+            box.correction(r_vec, correction, correction_potential);
+
+            Eigen::Vector3d force = G * _planets[i].mass * _planets[j].mass * (correction - std::pow(r_mag*r_mag + s * s, -1.5) * r_vec);
+            forces[i] += force;
+            forces[j] -= force;
+        }
+    }
+
+    return forces;
+}
+
 std::vector<Eigen::Vector3d> Universe::hq_calculate_force(const double & G) const
 {
     std::vector<Eigen::Vector3d> forces(_planets.size(), Eigen::Vector3d(0,0,0));
     for(int i = 0; i < _planets.size(); i++){
-        double inside_mass = hq_calculate_mass(_magnitudes[i]);
-        forces[i] = -1 * G * _planets[i].mass * inside_mass / (_magnitudes[i] * _magnitudes[i]) * _planets[i].position.normalized();
+        double magnitude = _planets[i].position.norm();
+        double inside_mass = hq_calculate_mass(magnitude);
+        forces[i] = -1 * G * _planets[i].mass * inside_mass / (magnitude * magnitude) * _planets[i].position.normalized();
     }
     return forces;
 }
@@ -55,18 +82,25 @@ std::vector<Eigen::Vector3d> Universe::hq_calculate_force(const double & G) cons
 double Universe::calculate_mass_specifically(const double & radius) const
 {
     /*
-    Since all particles have the same mass, we only have to count how many
-    magnitudes fall below the radius threshhold
-    from which we can just multiply it with the mass
+    The radii are sorted, so the planets inside the radius are the ones in front of
+    the first radius which is not smaller, the cumulative mass then gives their mass
     */
+    auto first_outside = std::ranges::lower_bound(_radius_index, radius, {}, &RadiusEntry::radius);
+
+    return first_outside != _radius_index.begin() ? std::prev(first_outside)->cumulative_mass : 0.0;
+}
+
+double Universe::lagrangian_radius(double fraction) const
+{
+    // the masses are added up with rounding errors, so we allow for a tiny bit less than the exact fraction
+    double target = fraction * _total_mass * (1 - 1e-12);
 
-    std::size_t count = std::count_if(
-        _magnitudes.begin(),
-        _magnitudes.end(),
-        [radius](double x) {return x < radius; }
-    );
+    // the first planet with at least the target mass strictly inside of it
+    std::size_t index = std::ranges::lower_bound(_radius_index, target, {}, &RadiusEntry::cumulative_mass) - _radius_index.begin() + 1;
+    if (target <= 0)
+        index = 0;
 
-    return count * _planets[0].mass;
+    return _radius_index[std::min(index, _radius_index.size() - 1)].radius;
 }
 
 double Universe::hq_calculate_mass(const double & radius) const
@@ -77,28 +111,35 @@ double Universe::hq_calculate_mass(const double & radius) const
     return _total_mass * radius * radius / ((radius + _scale_factor) * (radius + _scale_factor));
 }
 
-void Universe::_compute_half_mass_radius()
+RadialProfile Universe::calculate_radial_profile(std::size_t n_bins, double G, unsigned int n_threads) const
 {
-    // calculate the half mass radius
-    auto sorted_magnitudes = _magnitudes;
-    std::sort(sorted_magnitudes.begin(), sorted_magnitudes.end());
-    int center_index = sorted_magnitudes.size() / 2;
-    _half_mass_radius = sorted_magnitudes[center_index];
+    // a planet exactly at the center would give log(0), so the innermost radius is kept away from 0
+    double r_max = std::nextafter(_radius_index.back().radius, INFINITY);
+    double r_min = std::max(_radius_index.front().radius, r_max * 1e-6);
+
+    RadialProfile profile(r_min, r_max, n_bins, n_threads);
+    profile.compute(_planets, G, _total_mass, _scale_factor);
+    return profile;
 }
 
-void Universe::_compute_magnitudes()
+void Universe::_build_radius_index()
 {
-    // calculate the magnitudes list
-    for (auto const &planet : _planets)
+    // first every entry holds the radius and the mass of one planet
+    _radius_index.resize(_planets.size());
+    for (std::size_t i = 0; i < _planets.size(); i++)
     {
-        _magnitudes.push_back(planet.position.norm());
+        _radius_index[i] = RadiusEntry{_planets[i].position.norm(), _planets[i].mass};
     }
-}
 
-void Universe::_relist_positions()
-{
-    for(const auto planet : _planets)
+    // sorting the entries themselves needs no extra list of indices
+    std::sort(_radius_index.begin(), _radius_index.end(),
+              [](const RadiusEntry &a, const RadiusEntry &b) { return a.radius < b.radius; });
+
+    // then the masses are added up in place
+    double mass = 0;
+    for (auto &entry : _radius_index)
     {
-        _positions.push_back(planet.position);
+        mass += entry.cumulative_mass;
+        entry.cumulative_mass = mass;
     }
-}
\ No newline at end of file
+}